@@ -0,0 +1,219 @@
+/*
+ * Runs the microbenchmark suite (main/bench.c) on the host, or reads the BENCH: lines the
+ * console command bench printed on the target, and compares the results with a baseline.
+ *
+ *   bench [-r reps] [-f filter] [-l logfile] [-o results.csv] [-b baseline.csv] [-t percent]
+ *     -r  repetitions per benchmark, default 15
+ *     -f  only benchmarks whose name contains filter
+ *     -l  take the results from a target console log instead of running them
+ *     -o  write the results as csv, usable as baseline
+ *     -b  compare with a baseline, exit status 1 on a regression
+ *     -t  median slowdown counted as regression, default 25%
+ *
+ * A host run also prints the i2c traffic and command link heap calls of one VU meter frame as
+ * sent by the display driver.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "SSD1306/lcd.h"
+#include "i2c_shim.h"
+
+#define MAX_RESULTS     64
+#define NAME_LEN        32
+
+typedef struct {
+    char name[NAME_LEN];
+    uint32_t ops;
+    uint32_t reps;
+    float ns_median;
+    float ns_min;
+} result_t;
+
+typedef struct {
+    result_t r[MAX_RESULTS];
+    int count;
+} results_t;
+
+
+static bool parse_line(const char *line, result_t *r) {
+    return sscanf(line, "%31[^,],%u,%u,%f,%f", r->name, &r->ops, &r->reps, &r->ns_median, &r->ns_min) == 5;
+}
+
+static bool read_log(const char *path, results_t *res) {
+    FILE *in = fopen(path, "r");
+    char line[256];
+    if (in == NULL) return false;
+
+    while (fgets(line, sizeof(line), in)) {
+        char *p = strstr(line, "BENCH:");
+        if (!p) continue;
+        p += strlen("BENCH:");
+        //a new run replaces the previous one
+        if (strncmp(p, "BEGIN", 5) == 0) res->count = 0;
+        else if (res->count < MAX_RESULTS && parse_line(p, &res->r[res->count])) res->count++;
+    }
+    fclose(in);
+    return res->count > 0;
+}
+
+static bool read_csv(const char *path, results_t *res) {
+    FILE *in = fopen(path, "r");
+    char line[256];
+    if (in == NULL) return false;
+
+    while (fgets(line, sizeof(line), in) && res->count < MAX_RESULTS) {
+        if (parse_line(line, &res->r[res->count])) res->count++;
+    }
+    fclose(in);
+    return true;
+}
+
+static bool write_csv(const char *path, const results_t *res) {
+    FILE *out = fopen(path, "w");
+    if (out == NULL) return false;
+
+    fprintf(out, "name,ops,reps,ns_median,ns_min\n");
+    for (int i = 0; i < res->count; i++) {
+        const result_t *r = &res->r[i];
+        fprintf(out, "%s,%u,%u,%.1f,%.1f\n", r->name, r->ops, r->reps, r->ns_median, r->ns_min);
+    }
+    return fclose(out) == 0;
+}
+
+//left bar grows to full scale, right bar decays, as render_vu_meter draws it
+static void print_vu_frame_traffic() {
+    static const uint32_t freqs[] = { 100000, 400000, 1000000 };
+    lcd_stats_t s;
+    i2c_shim_counters_t c;
+
+    for (int i = 0; i < sizeof(freqs) / sizeof(freqs[0]); i++) {
+        lcd_set_bus(freqs[i], 0);
+        fb_clear();
+        fb_draw_rectangle(88, 7 * 8 + 5, 127, 7 * 8 + 7, 1);
+        fb_show();
+        fb_draw_rectangle(88, 7 * 8, 127, 7 * 8 + 2, 1);
+        fb_clear_rectangle(108, 7 * 8 + 5, 127, 7 * 8 + 7);
+        i2c_shim_reset_counters();
+        fb_show();
+        lcd_get_stats(&s);
+        i2c_shim_get_counters(&c);
+        printf("i2c per VU meter frame at %4u kHz: %u transactions, %u bytes, %u us, %u heap calls\n",
+               freqs[i] / 1000, s.frame_transactions, s.frame_bytes, s.frame_bus_us, c.heap_calls);
+    }
+}
+
+//a full screen change with the VU bars moving every frame, as the refresh task would send it
+static void print_budget_frames(uint32_t freq_hz, uint32_t budget_us) {
+    lcd_stats_t s;
+    uint32_t frames = 0, max_us = 0;
+
+    lcd_set_bus(freq_hz, budget_us);
+    lcd_set_priority_region(88, 127, 7, 7);
+    fb_clear();
+    fb_show();
+    fb_draw_rectangle(0, 0, 127, 6 * 8 - 1, 1);
+    lcd_get_stats(&s);
+    for (uint32_t deferred = ~s.deferred; deferred != s.deferred && frames < 100; frames++) {
+        deferred = s.deferred;
+        fb_draw_rectangle(88, 7 * 8, 88 + frames % 40, 7 * 8 + 2, 1);
+        fb_clear_rectangle(89 + frames % 40, 7 * 8, 127, 7 * 8 + 2);
+        fb_show();
+        lcd_get_stats(&s);
+        if (s.frame_bus_us > max_us) max_us = s.frame_bus_us;
+    }
+    printf("6 pages redrawn at %4u kHz, %u us budget: %u frames, max %u us per frame\n",
+           freq_hz / 1000, budget_us, frames, max_us);
+    lcd_set_bus(freq_hz, 0);
+}
+
+static int compare(const results_t *res, const results_t *base, float threshold) {
+    int regressions = 0;
+
+    printf("%-20s %12s %12s %8s\n", "benchmark", "baseline ns", "now ns", "change");
+    for (int i = 0; i < res->count; i++) {
+        const result_t *r = &res->r[i];
+        const result_t *b = NULL;
+        for (int j = 0; j < base->count; j++) {
+            if (strcmp(base->r[j].name, r->name) == 0) b = &base->r[j];
+        }
+        if (b == NULL || b->ns_median <= 0) {
+            printf("%-20s %12s %12.1f %8s\n", r->name, "-", r->ns_median, "new");
+            continue;
+        }
+        float change = (r->ns_median / b->ns_median - 1) * 100;
+        bool regression = change > threshold;
+        regressions += regression;
+        printf("%-20s %12.1f %12.1f %+7.1f%%%s\n", r->name, b->ns_median, r->ns_median, change,
+               regression ? "  REGRESSION" : "");
+    }
+    return regressions;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t reps = 15;
+    const char *filter = NULL, *log = NULL, *out = NULL, *baseline = NULL;
+    float threshold = 25;
+    results_t res = { .count = 0 };
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:f:l:o:b:t:")) != -1) {
+        switch (opt) {
+        case 'r': reps = strtoul(optarg, NULL, 0); break;
+        case 'f': filter = optarg; break;
+        case 'l': log = optarg; break;
+        case 'o': out = optarg; break;
+        case 'b': baseline = optarg; break;
+        case 't': threshold = atof(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-r reps] [-f filter] [-l logfile] [-o results.csv] [-b baseline.csv] [-t percent]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (log) {
+        if (!read_log(log, &res)) {
+            fprintf(stderr, "%s: no BENCH: results found\n", log);
+            return 2;
+        }
+    }
+    else {
+        printf("BENCH:BEGIN host\n");
+        for (int i = 0; i < bench_count() && res.count < MAX_RESULTS; i++) {
+            if (filter && !strstr(bench_name(i), filter)) continue;
+            bench_result_t r;
+            bench_run(i, reps, &r);
+            result_t *o = &res.r[res.count++];
+            snprintf(o->name, NAME_LEN, "%s", r.name);
+            o->ops = r.ops;
+            o->reps = r.reps;
+            o->ns_median = r.ns_median;
+            o->ns_min = r.ns_min;
+            printf("BENCH:%s,%u,%u,%.1f,%.1f\n", o->name, o->ops, o->reps, o->ns_median, o->ns_min);
+        }
+        printf("BENCH:END\n");
+        print_vu_frame_traffic();
+        print_budget_frames(400000, 4000);
+        print_budget_frames(1000000, 4000);
+    }
+
+    if (out && !write_csv(out, &res)) {
+        perror(out);
+        return 2;
+    }
+    if (baseline) {
+        results_t base = { .count = 0 };
+        if (!read_csv(baseline, &base)) {
+            perror(baseline);
+            return 2;
+        }
+        return compare(&res, &base, threshold) ? 1 : 0;
+    }
+    return 0;
+}
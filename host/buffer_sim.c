@@ -0,0 +1,375 @@
+/*
+ * Discrete-event simulation of the path from the bluetooth data callback through the ring
+ * buffer and the i2s task into the DMA buffers, to choose ring buffer and DMA sizes from data.
+ *
+ * Packets arrive from a synthetic bursty source or from a recorded trace (csv from
+ * trace_decode -c, or lines "t_us bytes"). The data callback doubles each packet to 32 bit
+ * samples and writes it into the byte ring buffer, blocking up to RINGBUF_WRITE_TIMEOUT_MS
+ * when full and dropping the packet after that. The i2s task takes the contiguous part of
+ * the ring, copies it into the DMA buffers and returns it to the ring when all of it fits.
+ * The DMA plays one full buffer per dma_buf_len frames at the DAC rate and plays silence
+ * when none is ready.
+ *
+ *   buffer_sim [options]
+ *     -R sizes    ring buffer sizes, comma separated (default 8192,16384,24576,40960)
+ *     -C counts   dma_buf_count values (default 4,6,8,12,16)
+ *     -L lens     dma_buf_len values in frames (default 120,256,512)
+ *     -t seconds  simulated time (default 60)
+ *     -f rate     sample rate (default 44100)
+ *     -o ppm      source clock offset against the DAC (default 0)
+ *     -n bytes    16 bit packet size (default 4096)
+ *     -j ms       uniform packet jitter (default 5)
+ *     -g p,ms     per packet probability and length of a radio gap (default 0.002,60)
+ *     -w us       maximum i2s task wake-up latency (default 500)
+ *     -i file     packet arrival trace instead of the synthetic source
+ *     -s seed     random seed (default 1)
+ *     -c          csv output
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/param.h>
+
+#include "bt_app_core.h"
+#include "trace.h"
+
+#define MAX_VALUES      16
+#define NEVER           INFINITY
+#define FRAME_BYTES     8           //32 bit stereo
+
+typedef struct {
+    double t;                       //arrival time in s
+    uint32_t bytes;                 //16 bit data
+} packet_t;
+
+typedef struct {
+    packet_t *packets;
+    size_t count;
+    double duration;
+} arrivals_t;
+
+typedef struct {
+    uint32_t ringbuf_size;
+    uint16_t dma_buf_count;
+    uint16_t dma_buf_len;
+} sim_config_t;
+
+typedef struct {
+    double latency_sum;
+    double latency_max;
+    uint64_t latency_samples;
+    uint32_t underruns;             //dry periods while streaming
+    uint32_t underrun_buffers;      //DMA buffers played as silence
+    uint32_t overflows;             //writes that had to wait for room
+    uint32_t drops;                 //packets dropped after the write timeout
+    double writer_blocked_max;
+} sim_result_t;
+
+static struct {
+    double seconds;
+    uint32_t rate;
+    double ppm;
+    uint32_t packet_bytes;
+    double jitter_ms;
+    double gap_p;
+    double gap_ms;
+    double wake_us;
+    uint64_t seed;
+    bool csv;
+} opt = { 60, 44100, 0, 4096, 5, 0.002, 60, 500, 1, false };
+
+static uint64_t rng_state;
+
+static double rnd() {
+    //xorshift64*, reproducible across platforms
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (rng_state * 0x2545F4914F6CDD1Dull >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static void arrivals_add(arrivals_t *a, double t, uint32_t bytes) {
+    static size_t size = 0;
+    if (a->count == size) {
+        size = size ? size * 2 : 4096;
+        a->packets = realloc(a->packets, size * sizeof(packet_t));
+    }
+    a->packets[a->count].t = t;
+    a->packets[a->count].bytes = bytes;
+    a->count++;
+}
+
+static void arrivals_synthetic(arrivals_t *a) {
+    double source_rate = opt.rate * (1 + opt.ppm / 1e6);
+    double interval = opt.packet_bytes / 4.0 / source_rate;
+    double gap_end = 0;
+    double last = 0;
+
+    rng_state = opt.seed;
+    for (uint64_t i = 0; i * interval < opt.seconds; i++) {
+        double t = i * interval;
+        if (t >= gap_end && rnd() < opt.gap_p) gap_end = t + opt.gap_ms / 1000;
+        //packets of a radio gap arrive together when it ends
+        if (t < gap_end) t = gap_end;
+        t += rnd() * opt.jitter_ms / 1000;
+        if (t < last) t = last;
+        arrivals_add(a, t, opt.packet_bytes);
+        last = t;
+    }
+    a->duration = opt.seconds;
+}
+
+static bool arrivals_read(arrivals_t *a, const char *path) {
+    FILE *in = fopen(path, "r");
+    char line[256], event[32];
+    double t0 = -1;
+    unsigned long long t_us;
+    unsigned bytes;
+
+    if (in == NULL) return false;
+    while (fgets(line, sizeof(line), in)) {
+        //trace_decode -c: t_us,event,arg
+        if (sscanf(line, "%llu,%31[^,],%u", &t_us, event, &bytes) == 3) {
+            if (strcmp(event, trace_event_name(TRACE_EVT_PKT_IN)) != 0) continue;
+        }
+        else if (sscanf(line, "%llu %u", &t_us, &bytes) != 2) {
+            continue;
+        }
+        if (t0 < 0) t0 = t_us / 1e6;
+        arrivals_add(a, t_us / 1e6 - t0, bytes);
+    }
+    fclose(in);
+    if (a->count == 0) return false;
+    a->duration = a->packets[a->count - 1].t;
+    return true;
+}
+
+typedef struct {
+    const sim_config_t *cfg;
+    sim_result_t *r;
+    //ring buffer
+    uint32_t ring_read;
+    uint32_t ring_used;
+    //i2s task, item taken from the ring of which item_left bytes are not yet in DMA
+    uint32_t item;
+    uint32_t item_left;
+    bool task_waits_ring;
+    bool task_waits_dma;
+    double t_task;
+    //DMA, bytes in the buffers
+    uint64_t dma_bytes;
+    //data callback, packets queue up in the stack while it is blocked
+    bool writer_blocked;
+    double writer_blocked_since;
+    double writer_free;
+} sim_t;
+
+static void task_wake(sim_t *s, double t) {
+    s->t_task = t + rnd() * opt.wake_us / 1e6;
+}
+
+static bool ring_write(sim_t *s, uint32_t bytes, double t) {
+    if (s->cfg->ringbuf_size - s->ring_used < bytes) return false;
+    s->ring_used += bytes;
+    if (s->task_waits_ring) {
+        s->task_waits_ring = false;
+        task_wake(s, t);
+    }
+    return true;
+}
+
+static void task_run(sim_t *s) {
+    const uint64_t dma_size = (uint64_t)s->cfg->dma_buf_count * s->cfg->dma_buf_len * FRAME_BYTES;
+
+    s->t_task = NEVER;
+    for (;;) {
+        if (s->item == 0) {
+            if (s->ring_used == 0) {
+                s->task_waits_ring = true;
+                return;
+            }
+            //byte buffer hands out the contiguous part up to the wrap point
+            s->item = s->cfg->ringbuf_size - s->ring_read;
+            if (s->item > s->ring_used) s->item = s->ring_used;
+            s->item_left = s->item;
+        }
+        //i2s_write blocks until everything is in the DMA buffers
+        uint64_t n = dma_size - s->dma_bytes;
+        if (n > s->item_left) n = s->item_left;
+        s->dma_bytes += n;
+        s->item_left -= n;
+        if (s->item_left) {
+            s->task_waits_dma = true;
+            return;
+        }
+        s->ring_read = (s->ring_read + s->item) % s->cfg->ringbuf_size;
+        s->ring_used -= s->item;
+        s->item = 0;
+    }
+}
+
+static void writer_unblock(sim_t *s, double t) {
+    double blocked = t - s->writer_blocked_since;
+    if (blocked > s->r->writer_blocked_max) s->r->writer_blocked_max = blocked;
+    s->writer_blocked = false;
+    s->writer_free = t;
+}
+
+static void simulate(const arrivals_t *arrivals, const sim_config_t *cfg, sim_result_t *r) {
+    const double dma_period = (double)cfg->dma_buf_len / opt.rate;
+    const uint32_t dma_buf_bytes = cfg->dma_buf_len * FRAME_BYTES;
+    const double write_timeout = RINGBUF_WRITE_TIMEOUT_MS / 1000.0;
+    double t_dma = dma_period;
+    bool streaming = false, dry = false;
+    size_t next_pkt = 0;
+    sim_t s = { .cfg = cfg, .r = r, .task_waits_ring = true, .t_task = NEVER };
+
+    memset(r, 0, sizeof(*r));
+    rng_state = opt.seed * 7919;
+
+    for (;;) {
+        double t_pkt = NEVER;
+        if (s.writer_blocked) t_pkt = s.writer_blocked_since + write_timeout;
+        else if (next_pkt < arrivals->count) t_pkt = fmax(arrivals->packets[next_pkt].t, s.writer_free);
+        double t = fmin(fmin(t_pkt, t_dma), s.t_task);
+        if (t > arrivals->duration + 1) break;
+
+        if (t == s.t_task) {
+            task_run(&s);
+            //the ring may have room for a blocked writer now
+            if (s.writer_blocked && ring_write(&s, MIN(arrivals->packets[next_pkt].bytes * 2, cfg->ringbuf_size), t)) {
+                writer_unblock(&s, t);
+                next_pkt++;
+            }
+        }
+        else if (t == t_dma) {
+            t_dma += dma_period;
+            if (s.dma_bytes >= dma_buf_bytes) {
+                s.dma_bytes -= dma_buf_bytes;
+                streaming = true;
+                dry = false;
+                if (s.task_waits_dma) {
+                    s.task_waits_dma = false;
+                    task_wake(&s, t);
+                }
+            }
+            else if (streaming && t < arrivals->duration) {
+                //tx_desc_auto_clear plays silence
+                r->underrun_buffers++;
+                if (!dry) r->underruns++;
+                dry = true;
+            }
+            if (streaming && t < arrivals->duration) {
+                double latency = (double)(s.ring_used - (s.item - s.item_left) + s.dma_bytes) / FRAME_BYTES / opt.rate;
+                r->latency_sum += latency;
+                r->latency_samples++;
+                if (latency > r->latency_max) r->latency_max = latency;
+            }
+        }
+        else if (s.writer_blocked) {
+            //xRingbufferSend timed out, the packet is lost
+            r->drops++;
+            writer_unblock(&s, t);
+            next_pkt++;
+        }
+        else {
+            if (ring_write(&s, MIN(arrivals->packets[next_pkt].bytes * 2, cfg->ringbuf_size), t)) {
+                next_pkt++;
+            }
+            else {
+                r->overflows++;
+                s.writer_blocked = true;
+                s.writer_blocked_since = t;
+            }
+        }
+    }
+}
+
+static int parse_list(const char *arg, uint32_t *values) {
+    int n = 0;
+    char *end;
+    while (*arg && n < MAX_VALUES) {
+        values[n++] = strtoul(arg, &end, 0);
+        if (*end != ',' && *end != 0) return 0;
+        arg = *end ? end + 1 : end;
+    }
+    return n;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t rings[MAX_VALUES] = { 8192, 16384, 24576, 40960 };
+    uint32_t counts[MAX_VALUES] = { 4, 6, 8, 12, 16 };
+    uint32_t lens[MAX_VALUES] = { 120, 256, 512 };
+    int n_rings = 4, n_counts = 5, n_lens = 3;
+    const char *trace = NULL;
+    int o;
+
+    while ((o = getopt(argc, argv, "R:C:L:t:f:o:n:j:g:w:i:s:c")) != -1) {
+        switch (o) {
+        case 'R': n_rings = parse_list(optarg, rings); break;
+        case 'C': n_counts = parse_list(optarg, counts); break;
+        case 'L': n_lens = parse_list(optarg, lens); break;
+        case 't': opt.seconds = atof(optarg); break;
+        case 'f': opt.rate = strtoul(optarg, NULL, 0); break;
+        case 'o': opt.ppm = atof(optarg); break;
+        case 'n': opt.packet_bytes = strtoul(optarg, NULL, 0); break;
+        case 'j': opt.jitter_ms = atof(optarg); break;
+        case 'g': if (sscanf(optarg, "%lf,%lf", &opt.gap_p, &opt.gap_ms) != 2) goto usage; break;
+        case 'w': opt.wake_us = atof(optarg); break;
+        case 'i': trace = optarg; break;
+        case 's': opt.seed = strtoull(optarg, NULL, 0); break;
+        case 'c': opt.csv = true; break;
+        default: goto usage;
+        }
+    }
+    if (!n_rings || !n_counts || !n_lens || !opt.rate || !opt.packet_bytes || !opt.seed || optind != argc) goto usage;
+
+    arrivals_t arrivals = { 0 };
+    if (trace) {
+        if (!arrivals_read(&arrivals, trace)) {
+            fprintf(stderr, "%s: no packet arrivals found\n", trace);
+            return 1;
+        }
+    }
+    else {
+        arrivals_synthetic(&arrivals);
+    }
+
+    if (opt.csv) {
+        printf("ringbuf,dma_count,dma_len,memory,latency_avg_ms,latency_max_ms,underruns,underrun_ms,overflows,drops,writer_blocked_max_ms\n");
+    }
+    else {
+        printf("%zu packets over %.1f s at %u Hz, %s\n", arrivals.count, arrivals.duration, opt.rate,
+               trace ? trace : "synthetic source");
+        printf("%8s %5s %5s %8s %9s %9s %9s %11s %9s %6s %11s\n", "ringbuf", "dma n", "len", "memory",
+               "lat avg", "lat max", "underruns", "silence ms", "overflows", "drops", "blocked max");
+    }
+    for (int ri = 0; ri < n_rings; ri++) {
+        for (int ci = 0; ci < n_counts; ci++) {
+            for (int li = 0; li < n_lens; li++) {
+                sim_config_t cfg = { rings[ri], counts[ci], lens[li] };
+                sim_result_t r;
+                simulate(&arrivals, &cfg, &r);
+
+                uint32_t memory = cfg.ringbuf_size + cfg.dma_buf_count * cfg.dma_buf_len * FRAME_BYTES;
+                double avg_ms = r.latency_samples ? r.latency_sum / r.latency_samples * 1000 : 0;
+                double silence_ms = r.underrun_buffers * 1000.0 * cfg.dma_buf_len / opt.rate;
+                printf(opt.csv ? "%u,%u,%u,%u,%.2f,%.2f,%u,%.1f,%u,%u,%.1f\n"
+                               : "%8u %5u %5u %8u %6.1f ms %6.1f ms %9u %11.1f %9u %6u %8.1f ms\n",
+                       cfg.ringbuf_size, cfg.dma_buf_count, cfg.dma_buf_len, memory, avg_ms, r.latency_max * 1000,
+                       r.underruns, silence_ms, r.overflows, r.drops, r.writer_blocked_max * 1000);
+            }
+        }
+    }
+    free(arrivals.packets);
+    return 0;
+
+usage:
+    fprintf(stderr, "usage: %s [-R sizes] [-C counts] [-L lens] [-t s] [-f rate] [-o ppm] [-n bytes] [-j ms] [-g p,ms] [-w us] [-i trace] [-s seed] [-c]\n", argv[0]);
+    return 1;
+}
@@ -0,0 +1,242 @@
+/*
+ * Bit-exact check of the framebuffer drawing primitives (main/SSD1306/lcd.c).
+ *
+ * Rectangles, lines, bitmaps and text are drawn into a framebuffer holding random content,
+ * once through the page blitter and once through an independent per pixel model with the
+ * uint8_t coordinate arithmetic of the original pixel loops, and the buffers compared.
+ * Every y range is covered for a set of x ranges, including ranges that run past the
+ * screen and wrap around at 256, followed by random operations. Text is modelled on the
+ * original walk through the font table, clipped at the right edge, and cached text is
+ * drawn from a few strings so it is both rendered and taken from the cache.
+ *
+ *   fb_check [-n random_ops]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "SSD1306/lcd.h"
+
+#define RANDOM_OPS          200000
+#define TEXTS               6
+
+//font.h defines the tables, they are linked from the display driver
+extern const unsigned char font[];
+extern const unsigned char font2[][20];
+
+typedef enum {
+    OP_RECT,
+    OP_RECT_FILLED,
+    OP_CLEAR,
+    OP_H_LINE,
+    OP_V_LINE,
+    OP_BITMAP,
+    OP_STRING,
+    OP_STRING_BIG,
+    OP_TEXT,
+    OP_TEXT_BIG,
+    OP_MAX,
+} op_t;
+
+static const char *op_names[OP_MAX] = { "rectangle", "filled rectangle", "clear rectangle", "h line", "v line", "bitmap", "string", "big string",
+                                          "text", "big text" };
+
+static uint8_t model[SSD1306_BUFFERSIZE];
+static char texts[TEXTS][FB_TEXT_LEN + 4];
+static fb_text_t text_cache;
+static uint32_t rng = 1;
+
+
+static uint32_t next_random() {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+//the pixel loops as they were, written for clarity only
+static void model_pixel(uint8_t x, uint8_t y, uint8_t on) {
+    if (x >= SSD1306_WIDTH || y >= SSD1306_HEIGHT) return;
+    if (on) model[x + (y / 8) * SSD1306_WIDTH] |= 1 << (y & 7);
+    else model[x + (y / 8) * SSD1306_WIDTH] &= ~(1 << (y & 7));
+}
+
+static void model_v_line(uint8_t x, uint8_t y, uint8_t length) {
+    for (uint8_t i = 0; i < length; ++i) model_pixel(x, i + y, 1);
+}
+
+static void model_h_line(uint8_t x, uint8_t y, uint8_t length) {
+    for (uint8_t i = 0; i < length; ++i) model_pixel(i + x, y, 1);
+}
+
+static void model_area(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint8_t on) {
+    uint8_t length = x2 - x1 + 1;
+    uint8_t height = y2 - y1;
+    for (uint8_t x = 0; x < length; ++x) {
+        for (uint8_t y = 0; y <= height; ++y) model_pixel(x1 + x, y + y1, on);
+    }
+}
+
+static void model_rect(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2) {
+    uint8_t length = x2 - x1 + 1;
+    uint8_t height = y2 - y1;
+    model_h_line(x1, y1, length);
+    model_h_line(x1, y2, length);
+    model_v_line(x1, y1, height);
+    model_v_line(x2, y1, height);
+}
+
+static void model_bitmap(uint8_t x, uint8_t y, const uint8_t *bitmap, uint8_t width, uint8_t height) {
+    for (int r = 0; r < height; r++) {
+        for (int c = 0; c < width; c++) {
+            if (x + c >= SSD1306_WIDTH || y + r >= SSD1306_HEIGHT) continue;
+            model_pixel(x + c, y + r, (bitmap[(r / 8) * width + c] >> (r & 7)) & 1);
+        }
+    }
+}
+
+static void model_column(int x, int page, uint8_t bits) {
+    if (x < SSD1306_WIDTH && page < SSD1306_HEIGHT / 8) model[page * SSD1306_WIDTH + x] = bits;
+}
+
+//gap is the column after a small glyph, left as it is by the string functions and cleared by the text cache
+static void model_string(int x, int page, const char *s, bool big, bool gap) {
+    for (; *s; s++) {
+        //font covers ' ' to '~', font2 goes on to 0xff, everything else is drawn as space
+        int c = (uint8_t)*s >= ' ' && (uint8_t)*s <= (big ? 0xff : '~') ? (uint8_t)*s - ' ' : 0;
+        if (big) {
+            for (int k = 0; k < 10; k++, x++) {
+                model_column(x, page, font2[c][k * 2]);
+                model_column(x, page + 1, font2[c][k * 2 + 1]);
+            }
+            continue;
+        }
+        int index = 0;
+        for (int k = 0; k < c; k++) index += font[index] + 1;
+        for (int k = 0; k < font[index]; k++, x++) model_column(x, page, font[index + 1 + k]);
+        if (gap) model_column(x, page, 0);
+        x++;
+    }
+}
+
+//draws with both, a, b, c, d are x1, y1, x2, y2, x, y, width, height or x, page, text
+static bool check(op_t op, uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+    static uint8_t bitmap[256 * 32];
+    uint8_t *fb = fb_buffer();
+
+    for (int i = 0; i < SSD1306_BUFFERSIZE; i++) fb[i] = next_random();
+    memcpy(model, fb, SSD1306_BUFFERSIZE);
+
+    switch (op) {
+    case OP_RECT:
+        fb_draw_rectangle(a, b, c, d, 0);
+        model_rect(a, b, c, d);
+        break;
+    case OP_RECT_FILLED:
+        fb_draw_rectangle(a, b, c, d, 1);
+        model_area(a, b, c, d, 1);
+        break;
+    case OP_CLEAR:
+        fb_clear_rectangle(a, b, c, d);
+        model_area(a, b, c, d, 0);
+        break;
+    case OP_H_LINE:
+        fb_draw_h_line(a, b, c);
+        model_h_line(a, b, c);
+        break;
+    case OP_V_LINE:
+        fb_draw_v_line(a, b, d);
+        model_v_line(a, b, d);
+        break;
+    case OP_BITMAP:
+        for (int i = 0; i < c * ((d + 7) / 8); i++) bitmap[i] = next_random();
+        fb_draw_bitmap(a, b, bitmap, c, d);
+        model_bitmap(a, b, bitmap, c, d);
+        break;
+    case OP_STRING:
+    case OP_STRING_BIG:
+        if (op == OP_STRING) fb_draw_string(a, b, texts[c]);
+        else fb_draw_string_big(a, b, texts[c]);
+        model_string(a, b, texts[c], op == OP_STRING_BIG, false);
+        break;
+    case OP_TEXT:
+    case OP_TEXT_BIG:
+        fb_draw_text(&text_cache, a, b, texts[c], op == OP_TEXT_BIG);
+        model_string(a, b, texts[c], op == OP_TEXT_BIG, true);
+        break;
+    default:
+        return false;
+    }
+    fb_invalidate();
+    return memcmp(fb, model, SSD1306_BUFFERSIZE) == 0;
+}
+
+static int check_report(op_t op, uint8_t a, uint8_t b, uint8_t c, uint8_t d, int *runs) {
+    //the original filled loops never ended for y2 one row above y1
+    if ((op == OP_RECT_FILLED || op == OP_CLEAR) && (uint8_t)(d - b) == 0xff) return 0;
+    (*runs)++;
+    if (check(op, a, b, c, d)) return 0;
+    printf("%s %u %u %u %u: differs from the pixel model\n", op_names[op], a, b, c, d);
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    static const uint8_t xs[][2] = { { 0, 127 }, { 0, 0 }, { 5, 83 }, { 84, 127 }, { 100, 140 }, { 127, 128 },
+                                     { 200, 20 }, { 250, 3 }, { 30, 29 }, { 140, 200 } };
+    long random_ops = RANDOM_OPS;
+    int failures = 0, runs = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+        case 'n': random_ops = atol(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n random_ops]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    for (size_t i = 0; i < sizeof(xs) / sizeof(xs[0]); i++) {
+        for (int y1 = 0; y1 < 256; y1 += y1 < 72 ? 1 : 23) {
+            for (int y2 = 0; y2 < 256; y2 += y2 < 72 ? 1 : 23) {
+                for (op_t op = OP_RECT; op <= OP_CLEAR; op++) failures += check_report(op, xs[i][0], y1, xs[i][1], y2, &runs);
+                failures += check_report(OP_H_LINE, xs[i][0], y1, y2, 0, &runs);
+                failures += check_report(OP_V_LINE, xs[i][0], y1, 0, y2, &runs);
+            }
+        }
+    }
+    for (int y = 0; y < 72; y++) {
+        for (int height = 1; height <= 24; height++) {
+            failures += check_report(OP_BITMAP, 0, y, 8, height, &runs);
+            failures += check_report(OP_BITMAP, 122, y, 10, height, &runs);
+        }
+    }
+    //printable text of up to FB_TEXT_LEN + 3 characters, the last one too long for the cache
+    for (int t = 0; t < TEXTS; t++) {
+        int len = t == TEXTS - 1 ? FB_TEXT_LEN + 3 : (int)(next_random() % FB_TEXT_LEN);
+        for (int i = 0; i < len; i++) texts[t][i] = next_random() % 16 ? ' ' + next_random() % 95 : 0x80 + next_random() % 0x80;
+        texts[t][len] = 0;
+    }
+    for (int x = 0; x < 140; x++) {
+        for (int page = 0; page < 9; page++) {
+            for (op_t op = OP_STRING; op <= OP_TEXT_BIG; op++) failures += check_report(op, x, page, x % TEXTS, 0, &runs);
+        }
+    }
+    for (long i = 0; i < random_ops; i++) {
+        op_t op = next_random() % OP_MAX;
+        uint8_t a = next_random(), b = next_random() % 80, c = next_random(), d = next_random() % 80;
+        if (op == OP_BITMAP) d = d % 32 + 1;
+        if (op >= OP_STRING) {
+            b %= 9;
+            c %= TEXTS;
+        }
+        failures += check_report(op, a, b, c, d, &runs);
+    }
+
+    printf("%d primitive runs: %s\n", runs, failures ? "FAILED" : "bit exact");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,87 @@
+/*
+ * Generator of the glyph index (main/SSD1306/font_index.h) of the display fonts.
+ *
+ * font[] stores every glyph as a width byte followed by its columns, so finding a glyph
+ * means walking the table from the start. The index holds the offset of every glyph.
+ * font2[] has a fixed size per glyph and only needs the glyph count. Without -u the
+ * index on disk is checked against the font tables.
+ *
+ *   font_index [-u] [-o index_file]
+ *     -u  rewrite the index file
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "SSD1306/font.h"
+
+#ifndef FONT_INDEX_FILE
+#define FONT_INDEX_FILE     "SSD1306/font_index.h"
+#endif
+
+#define INDEX_SIZE          8192
+
+
+static size_t index_make(char *out, size_t size) {
+    uint16_t offsets[256];
+    size_t glyphs = 0, n = 0;
+
+    for (size_t i = 0; i < sizeof(font); i += font[i] + 1) offsets[glyphs++] = i;
+
+    n += snprintf(out + n, size - n, "#pragma once\n\n"
+                  "/* Generated from font.h by host/font_index, rewrite with font_index -u after changing the fonts. */\n\n"
+                  "#include <stdint.h>\n\n"
+                  "#define FONT_FIRST          ' '\n"
+                  "#define FONT_GLYPHS         %zu\n"
+                  "#define FONT2_GLYPHS        %zu\n\n"
+                  "//offset of the width byte of each font[] glyph, from FONT_FIRST on\n"
+                  "static const uint16_t font_offset[FONT_GLYPHS] =\n{", glyphs, sizeof(font2) / sizeof(font2[0]));
+    for (size_t g = 0; g < glyphs; g++) {
+        n += snprintf(out + n, size - n, "%s%3u,", g % 12 ? " " : "\n    ", offsets[g]);
+    }
+    n += snprintf(out + n, size - n, "\n};\n");
+    return n;
+}
+
+int main(int argc, char *argv[]) {
+    const char *index_path = FONT_INDEX_FILE;
+    static char expected[INDEX_SIZE], actual[INDEX_SIZE];
+    bool update = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "uo:")) != -1) {
+        switch (opt) {
+        case 'u': update = true; break;
+        case 'o': index_path = optarg; break;
+        default:
+            fprintf(stderr, "usage: %s [-u] [-o index_file]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    size_t len = index_make(expected, sizeof(expected));
+    FILE *f = fopen(index_path, update ? "w" : "r");
+    if (f == NULL) {
+        perror(index_path);
+        return 2;
+    }
+    if (update) {
+        fwrite(expected, 1, len, f);
+        fclose(f);
+        printf("%s written\n", index_path);
+        return 0;
+    }
+
+    size_t actual_len = fread(actual, 1, sizeof(actual), f);
+    fclose(f);
+    if (actual_len != len || memcmp(actual, expected, len) != 0) {
+        printf("%s: out of date with font.h, rewrite it with -u\n", index_path);
+        return 1;
+    }
+    printf("%s: up to date\n", index_path);
+    return 0;
+}
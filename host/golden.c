@@ -0,0 +1,242 @@
+/*
+ * Bit-exact regression harness for the sample path (main/audio_pipeline.c).
+ *
+ * Runs reference signals through every volume step 0..127 and every kernel variant in
+ * packets of varying size, including odd sample counts. Each run is checked against an
+ * independent model (out = in * factor as little endian 32 bit, peaks per channel), the
+ * lossless claim at full volume (upper 16 bits equal the input, lower 16 bits zero), and a
+ * digest of output bytes, per packet VU levels and the volume factor stored in the golden
+ * file.
+ *
+ *   golden [-u] [-g golden_file]
+ *     -u  rewrite the golden file from the reference kernel, after the model check passed
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "audio_pipeline.h"
+#include "siggen.h"
+
+#ifndef GOLDEN_FILE
+#define GOLDEN_FILE         "golden/sample_path.txt"
+#endif
+
+#define SAMPLE_RATE         44100
+#define SIGNAL_FRAMES       (SAMPLE_RATE / 2)
+#define RAMP_SAMPLES        65536
+#define VOL_MIN             30
+#define VOL_POWER           3.0
+#define MAX_PACKET          4096
+
+typedef struct {
+    const char *name;
+    siggen_type_t type;             //SIGGEN_MAX: every 16 bit value once, then edge values
+    float freq;
+    float level_db;
+} signal_t;
+
+typedef struct {
+    uint32_t factor;
+    uint32_t crc_out;
+    uint32_t crc_levels;
+    uint32_t peak[2];
+} digest_t;
+
+static const signal_t signals[] = {
+    { "ramp",    SIGGEN_MAX,     0,   0 },
+    { "sine",    SIGGEN_SINE,    997, 0 },
+    { "sweep",   SIGGEN_SWEEP,   20,  -1 },
+    { "pink",    SIGGEN_PINK,    0,   -3 },
+    { "impulse", SIGGEN_IMPULSE, 100, 0 },
+};
+#define SIGNAL_COUNT        (int)(sizeof(signals) / sizeof(signals[0]))
+
+//packet sizes as seen from bluedroid plus odd sample counts and tiny tails
+static const size_t packet_sizes[] = { 4096, 2560, 1026, 6, 4094, 2, 512 };
+#define PACKET_SIZES        (int)(sizeof(packet_sizes) / sizeof(packet_sizes[0]))
+
+static uint32_t crc_table[256];
+
+
+static void crc_init() {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        crc_table[i] = c;
+    }
+}
+
+static uint32_t crc32(uint32_t crc, const void *data, size_t len) {
+    const uint8_t *p = data;
+    crc = ~crc;
+    while (len--) crc = crc_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static size_t signal_make(const signal_t *sig, uint8_t **pcm) {
+    static const int16_t edges[] = { -32768, 32767, 0, -1, 1, -32767, 16384, -16384, 255, -256, 256, -255 };
+
+    if (sig->type == SIGGEN_MAX) {
+        size_t len = (RAMP_SAMPLES + sizeof(edges) / sizeof(edges[0])) * 2;
+        *pcm = malloc(len);
+        for (int i = 0; i < RAMP_SAMPLES; i++) {
+            uint16_t v = (uint16_t)(i - 32768);
+            (*pcm)[2 * i] = (uint8_t)v;
+            (*pcm)[2 * i + 1] = (uint8_t)(v >> 8);
+        }
+        for (size_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++) {
+            (*pcm)[2 * (RAMP_SAMPLES + i)] = (uint8_t)edges[i];
+            (*pcm)[2 * (RAMP_SAMPLES + i) + 1] = (uint8_t)((uint16_t)edges[i] >> 8);
+        }
+        return len;
+    }
+
+    siggen_config_t cfg;
+    siggen_t gen;
+    siggen_default_config(&cfg);
+    cfg.type = sig->type;
+    cfg.sample_rate = SAMPLE_RATE;
+    cfg.freq = sig->freq;
+    cfg.sweep_s = 0.5;
+    cfg.level_db = sig->level_db;
+    siggen_init(&gen, &cfg);
+    *pcm = malloc(SIGNAL_FRAMES * 4);
+    siggen_fill(&gen, *pcm, SIGNAL_FRAMES * 4);
+    return SIGNAL_FRAMES * 4;
+}
+
+//the model the kernels are checked against, written for clarity only
+static bool model_check(const uint8_t *in, size_t len, const uint8_t *out, uint32_t factor, const uint32_t level[2]) {
+    uint32_t peak[2] = { 0, 0 };
+    for (size_t i = 0; i + 1 < len; i += 2) {
+        int64_t sample = (int16_t)(in[i] | in[i + 1] << 8);
+        int64_t expected = sample * factor;
+        uint32_t bits = (uint32_t)(int32_t)expected;
+        uint32_t got = out[2 * i] | out[2 * i + 1] << 8 | out[2 * i + 2] << 16 | (uint32_t)out[2 * i + 3] << 24;
+        if (expected < INT32_MIN || expected > INT32_MAX || got != bits) return false;
+        //lossless at full volume
+        if (factor == AUDIO_VOLUME_FACTOR_MAX && ((got & 0xffff) || (int16_t)(got >> 16) != sample)) return false;
+        uint64_t magnitude = expected < 0 ? -expected : expected;
+        if (magnitude > peak[(i / 2) & 1]) peak[(i / 2) & 1] = magnitude;
+    }
+    return peak[0] == level[0] && peak[1] == level[1];
+}
+
+static bool run(const uint8_t *pcm, size_t pcm_len, audio_pipeline_kernel_t kernel, uint32_t factor, bool check, digest_t *d) {
+    static uint8_t out[MAX_PACKET * 2];
+    uint32_t level[2];
+    size_t pos = 0;
+    int n = 0;
+
+    memset(d, 0, sizeof(*d));
+    d->factor = factor;
+    while (pos < pcm_len) {
+        size_t len = packet_sizes[n++ % PACKET_SIZES];
+        if (len > pcm_len - pos) len = pcm_len - pos;
+        size_t da_len = kernel(pcm + pos, len, out, factor, level);
+        if (da_len != (len & ~(size_t)1) * 2) return false;
+        if (check && !model_check(pcm + pos, len, out, factor, level)) return false;
+
+        d->crc_out = crc32(d->crc_out, out, da_len);
+        d->crc_levels = crc32(d->crc_levels, level, sizeof(level));
+        if (level[0] > d->peak[0]) d->peak[0] = level[0];
+        if (level[1] > d->peak[1]) d->peak[1] = level[1];
+        pos += len;
+    }
+    return true;
+}
+
+static bool golden_find(FILE *golden, const char *signal, int volume, digest_t *d) {
+    char line[256], name[32];
+    int vol;
+    rewind(golden);
+    while (fgets(line, sizeof(line), golden)) {
+        if (sscanf(line, "%31s %d %u %x %x %u %u", name, &vol, &d->factor, &d->crc_out, &d->crc_levels,
+                   &d->peak[0], &d->peak[1]) == 7 && vol == volume && strcmp(name, signal) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char *argv[]) {
+    const char *golden_path = GOLDEN_FILE;
+    bool update = false;
+    int failures = 0, runs = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "ug:")) != -1) {
+        switch (opt) {
+        case 'u': update = true; break;
+        case 'g': golden_path = optarg; break;
+        default:
+            fprintf(stderr, "usage: %s [-u] [-g golden_file]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    FILE *golden = fopen(golden_path, update ? "w" : "r");
+    if (golden == NULL) {
+        perror(golden_path);
+        return 2;
+    }
+    if (update) {
+        fprintf(golden, "# signal volume factor crc_out crc_levels peak_l peak_r, volume curve min %d power %.1f\n",
+                VOL_MIN, VOL_POWER);
+    }
+
+    crc_init();
+    audio_volume_curve_t curve;
+    audio_pipeline_volume_curve(&curve, VOL_MIN, VOL_POWER);
+
+    for (int s = 0; s < SIGNAL_COUNT; s++) {
+        uint8_t *pcm;
+        size_t pcm_len = signal_make(&signals[s], &pcm);
+
+        for (int volume = 0; volume <= AUDIO_VOLUME_MAX; volume++) {
+            uint32_t factor = audio_pipeline_volume_factor(&curve, volume);
+            digest_t expected;
+            bool have_expected = !update && golden_find(golden, signals[s].name, volume, &expected);
+
+            if (!update && !have_expected) {
+                printf("%s volume %d: missing in %s\n", signals[s].name, volume, golden_path);
+                failures++;
+            }
+            for (int k = 0; k < audio_pipeline_kernel_count; k++) {
+                digest_t d;
+                runs++;
+                //the model check is slow, once per signal and volume is enough for the reference
+                if (!run(pcm, pcm_len, audio_pipeline_kernels[k].process, factor, k == 0, &d)) {
+                    printf("%s volume %d kernel %s: differs from the model\n", signals[s].name, volume, audio_pipeline_kernels[k].name);
+                    failures++;
+                    continue;
+                }
+                //when updating the other kernels are held against the reference
+                if (update && k == 0) {
+                    fprintf(golden, "%s %d %u %08x %08x %u %u\n", signals[s].name, volume, d.factor,
+                            d.crc_out, d.crc_levels, d.peak[0], d.peak[1]);
+                    expected = d;
+                    have_expected = true;
+                }
+                else if (have_expected && memcmp(&d, &expected, sizeof(d)) != 0) {
+                    printf("%s volume %d kernel %s: factor %u crc %08x/%08x peaks %u/%u, golden factor %u crc %08x/%08x peaks %u/%u\n",
+                           signals[s].name, volume, audio_pipeline_kernels[k].name, d.factor, d.crc_out, d.crc_levels,
+                           d.peak[0], d.peak[1], expected.factor, expected.crc_out, expected.crc_levels,
+                           expected.peak[0], expected.peak[1]);
+                    failures++;
+                }
+            }
+        }
+        free(pcm);
+    }
+    fclose(golden);
+
+    printf("%d signals x %d volumes x %d kernels, %d runs: %s%s\n", SIGNAL_COUNT, AUDIO_VOLUME_MAX + 1,
+           audio_pipeline_kernel_count, runs, failures ? "FAILED" : "bit exact", update && !failures ? ", golden file written" : "");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+/* host shim */
+
+typedef int esp_err_t;
+
+#define ESP_OK                  0
+#define ESP_FAIL                -1
+#define ESP_ERR_NO_MEM          0x101
+#define ESP_ERR_INVALID_ARG     0x102
+
+static inline const char *esp_err_to_name(esp_err_t code) {
+    return code == ESP_OK ? "ESP_OK" : code == ESP_ERR_NO_MEM ? "ESP_ERR_NO_MEM" :
+           code == ESP_ERR_INVALID_ARG ? "ESP_ERR_INVALID_ARG" : "ESP_FAIL";
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+/*
+ * host shim: single threaded byte buffer with the ESP-IDF ring buffer API.
+ * Timeouts are ignored, a send that does not fit fails immediately and a receive
+ * on an empty buffer returns NULL. Receive hands out the contiguous part up to the
+ * wrap point, like RINGBUF_TYPE_BYTEBUF.
+ */
+
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+
+typedef struct ringbuf_shim *RingbufHandle_t;
+
+typedef enum {
+    RINGBUF_TYPE_NOSPLIT = 0,
+    RINGBUF_TYPE_ALLOWSPLIT,
+    RINGBUF_TYPE_BYTEBUF,
+} RingbufferType_t;
+
+RingbufHandle_t xRingbufferCreate(size_t xBufferSize, RingbufferType_t xBufferType);
+void vRingbufferDelete(RingbufHandle_t xRingbuffer);
+BaseType_t xRingbufferSend(RingbufHandle_t xRingbuffer, const void *pvItem, size_t xItemSize, TickType_t xTicksToWait);
+void *xRingbufferReceive(RingbufHandle_t xRingbuffer, size_t *pxItemSize, TickType_t xTicksToWait);
+void *xRingbufferReceiveUpTo(RingbufHandle_t xRingbuffer, size_t *pxItemSize, TickType_t xTicksToWait, size_t xMaxSize);
+void vRingbufferReturnItem(RingbufHandle_t xRingbuffer, void *pvItem);
+size_t xRingbufferGetCurFreeSize(RingbufHandle_t xRingbuffer);
@@ -0,0 +1,15 @@
+#pragma once
+
+/* host shim: counters of the i2c master stub */
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t transactions;          //i2c_master_cmd_begin calls
+    uint32_t starts;                //start and repeated start conditions
+    uint64_t bytes;                 //written, address bytes included
+    uint32_t heap_calls;            //allocations and frees of command links
+} i2c_shim_counters_t;
+
+void i2c_shim_get_counters(i2c_shim_counters_t *c);
+void i2c_shim_reset_counters();
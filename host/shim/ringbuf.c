@@ -0,0 +1,69 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/ringbuf.h"
+
+
+struct ringbuf_shim {
+    uint8_t *data;
+    size_t size;
+    size_t read;
+    size_t used;
+    size_t lent;            //bytes handed out by receive and not yet returned
+};
+
+
+RingbufHandle_t xRingbufferCreate(size_t xBufferSize, RingbufferType_t xBufferType) {
+    RingbufHandle_t rb = calloc(1, sizeof(struct ringbuf_shim));
+    if (rb == NULL) return NULL;
+    rb->data = malloc(xBufferSize);
+    if (rb->data == NULL) {
+        free(rb);
+        return NULL;
+    }
+    rb->size = xBufferSize;
+    return rb;
+}
+
+void vRingbufferDelete(RingbufHandle_t xRingbuffer) {
+    free(xRingbuffer->data);
+    free(xRingbuffer);
+}
+
+BaseType_t xRingbufferSend(RingbufHandle_t xRingbuffer, const void *pvItem, size_t xItemSize, TickType_t xTicksToWait) {
+    RingbufHandle_t rb = xRingbuffer;
+    if (xItemSize > rb->size - rb->used) return pdFALSE;
+
+    size_t write = (rb->read + rb->used) % rb->size;
+    size_t first = rb->size - write < xItemSize ? rb->size - write : xItemSize;
+    memcpy(rb->data + write, pvItem, first);
+    memcpy(rb->data, (const uint8_t *)pvItem + first, xItemSize - first);
+    rb->used += xItemSize;
+    return pdTRUE;
+}
+
+void *xRingbufferReceiveUpTo(RingbufHandle_t xRingbuffer, size_t *pxItemSize, TickType_t xTicksToWait, size_t xMaxSize) {
+    RingbufHandle_t rb = xRingbuffer;
+    if (rb->used == 0 || rb->lent) return NULL;
+
+    size_t n = rb->size - rb->read < rb->used ? rb->size - rb->read : rb->used;
+    if (n > xMaxSize) n = xMaxSize;
+    rb->lent = n;
+    *pxItemSize = n;
+    return rb->data + rb->read;
+}
+
+void *xRingbufferReceive(RingbufHandle_t xRingbuffer, size_t *pxItemSize, TickType_t xTicksToWait) {
+    return xRingbufferReceiveUpTo(xRingbuffer, pxItemSize, xTicksToWait, xRingbuffer->size);
+}
+
+void vRingbufferReturnItem(RingbufHandle_t xRingbuffer, void *pvItem) {
+    RingbufHandle_t rb = xRingbuffer;
+    rb->read = (rb->read + rb->lent) % rb->size;
+    rb->used -= rb->lent;
+    rb->lent = 0;
+}
+
+size_t xRingbufferGetCurFreeSize(RingbufHandle_t xRingbuffer) {
+    return xRingbuffer->size - xRingbuffer->used;
+}
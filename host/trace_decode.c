@@ -0,0 +1,249 @@
+/*
+ * Decoder for the pipeline trace dump (main/trace.c).
+ *
+ * Reads a console log, picks the last TRACE:BEGIN ... TRACE:END block and prints a
+ * timeline, packet inter-arrival jitter and a ring buffer fill level graph.
+ *
+ *   trace_decode [-t] [-c] [-a] [logfile]
+ *     -t  print the timeline
+ *     -c  print records as csv (t_us,event,arg)
+ *     -a  decode every dump in the log, not only the last
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+#define GRAPH_WIDTH     72
+#define GRAPH_HEIGHT    16
+
+typedef struct {
+    uint64_t t_us;
+    uint8_t event;
+    uint32_t arg;
+} record_t;
+
+typedef struct {
+    record_t *records;
+    size_t count;
+    size_t size;
+} dump_t;
+
+
+static void dump_add(dump_t *d, uint32_t ts, uint32_t event_arg) {
+    //relative to the previous record, which may be a little later when it came from the other core
+    static uint64_t last_t = 0;
+    static uint32_t last_ts = 0;
+    if (d->count == 0) last_t = (1ull << 32) + ts;
+    else last_t += (int32_t)(ts - last_ts);
+    last_ts = ts;
+
+    if (d->count == d->size) {
+        d->size = d->size ? d->size * 2 : 1024;
+        d->records = realloc(d->records, d->size * sizeof(record_t));
+    }
+    trace_record_t r = { .ts = ts, .event_arg = event_arg };
+    d->records[d->count].t_us = last_t;
+    d->records[d->count].event = TRACE_EVENT(&r);
+    d->records[d->count].arg = TRACE_ARG(&r);
+    d->count++;
+}
+
+//records of both cores are written in the order they got a slot, not in time order
+static int cmp_record(const void *a, const void *b) {
+    uint64_t x = ((const record_t *)a)->t_us, y = ((const record_t *)b)->t_us;
+    return x < y ? -1 : x > y;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void print_intervals(const dump_t *d, trace_event_t event) {
+    double *iv = malloc(d->count * sizeof(double));
+    size_t n = 0;
+    uint64_t last = 0;
+    bool have_last = false;
+
+    for (size_t i = 0; i < d->count; i++) {
+        if (d->records[i].event != event) continue;
+        if (have_last) iv[n++] = (d->records[i].t_us - last) / 1000.0;
+        last = d->records[i].t_us;
+        have_last = true;
+    }
+    if (n < 2) {
+        printf("%-14s not enough records\n", trace_event_name(event));
+        free(iv);
+        return;
+    }
+
+    double sum = 0, sq = 0;
+    for (size_t i = 0; i < n; i++) sum += iv[i];
+    double mean = sum / n;
+    for (size_t i = 0; i < n; i++) sq += (iv[i] - mean) * (iv[i] - mean);
+    qsort(iv, n, sizeof(double), cmp_double);
+    printf("%-14s intervals %6zu  mean %7.2f ms  jitter (stddev) %6.2f ms  min %7.2f  p50 %7.2f  p99 %7.2f  max %7.2f\n",
+           trace_event_name(event), n, mean, sqrt(sq / n), iv[0], iv[n / 2], iv[(n * 99) / 100], iv[n - 1]);
+    free(iv);
+}
+
+static void print_fill_graph(const dump_t *d) {
+    uint32_t column_max[GRAPH_WIDTH];
+    bool column_set[GRAPH_WIDTH];
+    uint32_t fill_max = 0, fill_min = UINT32_MAX;
+    uint64_t fill_sum = 0;
+    size_t fill_count = 0;
+    uint64_t t0 = d->records[0].t_us;
+    uint64_t span = d->records[d->count - 1].t_us - t0 + 1;
+
+    memset(column_max, 0, sizeof(column_max));
+    memset(column_set, 0, sizeof(column_set));
+    for (size_t i = 0; i < d->count; i++) {
+        const record_t *r = &d->records[i];
+        if (r->event != TRACE_EVT_RING_WRITE && r->event != TRACE_EVT_RING_READ) continue;
+        size_t col = (r->t_us - t0) * GRAPH_WIDTH / span;
+        if (!column_set[col] || r->arg > column_max[col]) column_max[col] = r->arg;
+        column_set[col] = true;
+        if (r->arg > fill_max) fill_max = r->arg;
+        if (r->arg < fill_min) fill_min = r->arg;
+        fill_sum += r->arg;
+        fill_count++;
+    }
+    if (fill_count == 0) {
+        printf("no ring buffer records\n");
+        return;
+    }
+    printf("ring fill bytes: min %u  avg %llu  max %u  (%zu samples)\n",
+           fill_min, (unsigned long long)(fill_sum / fill_count), fill_max, fill_count);
+
+    uint32_t top = fill_max ? fill_max : 1;
+    for (int row = GRAPH_HEIGHT; row > 0; row--) {
+        printf("%7u |", top * row / GRAPH_HEIGHT);
+        for (int col = 0; col < GRAPH_WIDTH; col++) {
+            uint32_t h = column_set[col] ? (column_max[col] * GRAPH_HEIGHT + top - 1) / top : 0;
+            putchar(!column_set[col] ? ' ' : h >= (uint32_t)row ? '#' : '.');
+        }
+        putchar('\n');
+    }
+    printf("        +");
+    for (int col = 0; col < GRAPH_WIDTH; col++) putchar('-');
+    printf("\n         0 ms%*s%.1f ms\n", GRAPH_WIDTH - 10, "", span / 1000.0);
+}
+
+static void print_timeline(const dump_t *d) {
+    uint64_t last_of[TRACE_EVT_MAX];
+    memset(last_of, 0, sizeof(last_of));
+    uint64_t t0 = d->records[0].t_us;
+    uint64_t prev = t0;
+
+    printf("%12s %10s  %-14s %10s %12s\n", "t ms", "+ms", "event", "arg", "since same");
+    for (size_t i = 0; i < d->count; i++) {
+        const record_t *r = &d->records[i];
+        printf("%12.3f %10.3f  %-14s %10u", (r->t_us - t0) / 1000.0, (r->t_us - prev) / 1000.0,
+               trace_event_name(r->event), r->arg);
+        if (r->event < TRACE_EVT_MAX && last_of[r->event]) {
+            printf(" %12.3f", (r->t_us - last_of[r->event]) / 1000.0);
+        }
+        putchar('\n');
+        if (r->event < TRACE_EVT_MAX) last_of[r->event] = r->t_us;
+        prev = r->t_us;
+    }
+}
+
+static void print_dump(const dump_t *d, bool timeline, bool csv) {
+    size_t per_event[TRACE_EVT_MAX];
+    memset(per_event, 0, sizeof(per_event));
+
+    if (d->count == 0) {
+        printf("empty trace\n");
+        return;
+    }
+    if (csv) {
+        printf("t_us,event,arg\n");
+        for (size_t i = 0; i < d->count; i++) {
+            printf("%llu,%s,%u\n", (unsigned long long)(d->records[i].t_us - d->records[0].t_us),
+                   trace_event_name(d->records[i].event), d->records[i].arg);
+        }
+        return;
+    }
+    if (timeline) print_timeline(d);
+
+    for (size_t i = 0; i < d->count; i++) {
+        if (d->records[i].event < TRACE_EVT_MAX) per_event[d->records[i].event]++;
+    }
+    printf("%zu records over %.1f ms\n", d->count, (d->records[d->count - 1].t_us - d->records[0].t_us) / 1000.0);
+    for (int e = 1; e < TRACE_EVT_MAX; e++) {
+        if (per_event[e]) printf("  %-14s %zu\n", trace_event_name(e), per_event[e]);
+    }
+    print_intervals(d, TRACE_EVT_PKT_IN);
+    print_intervals(d, TRACE_EVT_I2S_DONE);
+    print_intervals(d, TRACE_EVT_DISPLAY_FLUSH);
+    print_fill_graph(d);
+}
+
+int main(int argc, char *argv[]) {
+    bool timeline = false, csv = false, all = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "tca")) != -1) {
+        switch (opt) {
+        case 't': timeline = true; break;
+        case 'c': csv = true; break;
+        case 'a': all = true; break;
+        default:
+            fprintf(stderr, "usage: %s [-t] [-c] [-a] [logfile]\n", argv[0]);
+            return 1;
+        }
+    }
+    FILE *in = stdin;
+    if (optind < argc && (in = fopen(argv[optind], "r")) == NULL) {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    dump_t dump = { 0 };
+    bool inside = false;
+    int dumps = 0;
+    char line[1024];
+    while (fgets(line, sizeof(line), in)) {
+        char *p = strstr(line, "TRACE:");
+        if (!p) continue;
+        p += strlen("TRACE:");
+        if (strncmp(p, "BEGIN", 5) == 0) {
+            dump.count = 0;
+            inside = true;
+        }
+        else if (strncmp(p, "END", 3) == 0 && inside) {
+            inside = false;
+            dumps++;
+            qsort(dump.records, dump.count, sizeof(record_t), cmp_record);
+            if (all) {
+                printf("=== dump %d ===\n", dumps);
+                print_dump(&dump, timeline, csv);
+            }
+        }
+        else if (inside) {
+            char hex[9] = { 0 };
+            while (strspn(p, "0123456789abcdefABCDEF") >= 16) {
+                memcpy(hex, p, 8);
+                uint32_t ts = strtoul(hex, NULL, 16);
+                memcpy(hex, p + 8, 8);
+                dump_add(&dump, ts, strtoul(hex, NULL, 16));
+                p += 16;
+            }
+        }
+    }
+    if (dumps == 0) {
+        fprintf(stderr, "no complete TRACE:BEGIN ... TRACE:END block found\n");
+        return 1;
+    }
+    if (!all) print_dump(&dump, timeline, csv);
+    free(dump.records);
+    return 0;
+}
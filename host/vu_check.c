@@ -0,0 +1,110 @@
+/*
+ * Table driven check of the VU meter scale and ballistics (main/vu_scale.c).
+ *
+ * The dB mapping is checked at the ends of the scale, on the column grid and for levels
+ * 20 dB and 6 dB down. The ballistics start from a settled reading, feed a step in frames
+ * of the given length and compare reading and peak marker with the ranges the standards
+ * give: 99% of a step after the integration time, a PPM falling 20 dB in 1.7 s, the peak
+ * marker held for its hold time, and elapsed time capped after a long gap.
+ *
+ *   vu_check
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "vu_scale.h"
+
+#define DB(x)               ((int32_t)((x) * 256))
+#define LEVEL_MAX           0x7fffffff
+
+typedef struct {
+    int32_t db;
+    uint8_t x;
+} column_case_t;
+
+typedef struct {
+    uint32_t level;
+    int32_t db_min, db_max;
+} level_case_t;
+
+typedef struct {
+    const char *name;
+    vu_ballistics_t ballistics;
+    int32_t from_db, to_db;         /*!< settled reading, then the input steps to to_db */
+    uint32_t frame_ms, total_ms;
+    int32_t db_min, db_max;         /*!< reading after total_ms */
+    int32_t peak_min, peak_max;     /*!< peak marker after total_ms */
+} meter_case_t;
+
+static const vu_ballistics_t ppm = { .integration_ms = 10, .fall_ms_per_db = 85, .peak_hold_ms = 1000 };
+static const vu_ballistics_t vu = { .integration_ms = 300, .fall_ms_per_db = 0, .peak_hold_ms = 0 };
+
+//the display bar: 80 dB over columns 88..127
+static const column_case_t column_cases[] = {
+    { 0, 127 },
+    { DB(10), 127 },
+    { VU_DB_MIN, 88 },
+    { DB(-100), 88 },
+    { DB(-40), 108 },
+    { DB(-20), 117 },
+    { DB(-60), 98 },
+};
+
+static const level_case_t level_cases[] = {
+    { LEVEL_MAX, 0, 0 },
+    { LEVEL_MAX / 10, DB(-20.1), DB(-19.9) },
+    { LEVEL_MAX / 2, DB(-6.1), DB(-5.9) },
+    { LEVEL_MAX / 10000, VU_DB_MIN, VU_DB_MIN },
+    { 0, VU_DB_MIN, VU_DB_MIN },
+};
+
+static const meter_case_t meter_cases[] = {
+    { "ppm rise, 99% after 10 ms",      ppm, VU_DB_MIN, DB(-10), 1, 10,        DB(-10.8), DB(-10), DB(-10.8), DB(-10) },
+    { "ppm rise, 5 ms frames",          ppm, VU_DB_MIN, DB(-10), 5, 10,        DB(-10.8), DB(-10), DB(-10.8), DB(-10) },
+    { "ppm rise, not instant",          ppm, VU_DB_MIN, DB(-10), 1, 1,         DB(-60), DB(-45), DB(-60), DB(-45) },
+    { "ppm fall, 20 dB in 1.7 s",       ppm, 0, VU_DB_MIN, 33, 1716,           DB(-20.5), DB(-19.5), DB(-12.2), DB(-11.4) },
+    { "ppm peak held for 1 s",          ppm, 0, VU_DB_MIN, 10, 900,            DB(-11), DB(-10), 0, 0 },
+    { "ppm peak released after 1 s",    ppm, 0, VU_DB_MIN, 10, 1100,           DB(-13.5), DB(-12.5), DB(-12.2), DB(-11.4) },
+    { "ppm stops at the input",         ppm, 0, DB(-6), 33, 2000,              DB(-6), DB(-6), DB(-6), DB(-6) },
+    { "ppm gap counts as 1 s",          ppm, 0, VU_DB_MIN, 5000, 5000,         DB(-12), DB(-11.5), DB(-12), DB(-11.5) },
+    { "vu rise, 99% after 300 ms",      vu, VU_DB_MIN, DB(-10), 33, 297,       DB(-10.8), DB(-10), DB(-10.8), DB(-10) },
+    { "vu fall, 99% after 300 ms",      vu, 0, VU_DB_MIN, 33, 330,             VU_DB_MIN, VU_DB_MIN + DB(0.8), VU_DB_MIN, VU_DB_MIN + DB(0.8) },
+};
+
+
+static int check_meter(const meter_case_t *c) {
+    vu_meter_t meter;
+
+    vu_meter_init(&meter);
+    meter.db = meter.peak_db = c->from_db;
+    for (uint32_t t = 0; t < c->total_ms; t += c->frame_ms) vu_meter_update(&meter, &c->ballistics, c->to_db, c->frame_ms);
+    if (meter.db >= c->db_min && meter.db <= c->db_max && meter.peak_db >= c->peak_min && meter.peak_db <= c->peak_max) return 0;
+    printf("%s: reading %.2f dB, expected %.2f..%.2f, peak %.2f dB, expected %.2f..%.2f\n", c->name,
+           meter.db / 256.0, c->db_min / 256.0, c->db_max / 256.0, meter.peak_db / 256.0, c->peak_min / 256.0, c->peak_max / 256.0);
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    vu_scale_t scale;
+    int failures = 0, runs = 0;
+
+    vu_scale_init(&scale, LEVEL_MAX, 88, 127);
+    for (size_t i = 0; i < sizeof(column_cases) / sizeof(column_cases[0]); i++, runs++) {
+        uint8_t x = vu_scale_db_x(&scale, column_cases[i].db);
+        if (x == column_cases[i].x) continue;
+        printf("%.2f dB: column %u, expected %u\n", column_cases[i].db / 256.0, x, column_cases[i].x);
+        failures++;
+    }
+    for (size_t i = 0; i < sizeof(level_cases) / sizeof(level_cases[0]); i++, runs++) {
+        int32_t db = vu_scale_db(&scale, level_cases[i].level);
+        if (db >= level_cases[i].db_min && db <= level_cases[i].db_max) continue;
+        printf("level %u: %.2f dB, expected %.2f..%.2f\n", level_cases[i].level, db / 256.0,
+               level_cases[i].db_min / 256.0, level_cases[i].db_max / 256.0);
+        failures++;
+    }
+    for (size_t i = 0; i < sizeof(meter_cases) / sizeof(meter_cases[0]); i++, runs++) failures += check_meter(&meter_cases[i]);
+
+    printf("%d scale and ballistics cases: %s\n", runs, failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,103 @@
+#include <string.h>
+
+#include "wav.h"
+
+
+static uint32_t get_le(const uint8_t *p, int bytes) {
+    uint32_t v = 0;
+    while (bytes--) v = v << 8 | p[bytes];
+    return v;
+}
+
+static void put_le(uint8_t *p, uint32_t v, int bytes) {
+    while (bytes--) {
+        *p++ = (uint8_t)v;
+        v >>= 8;
+    }
+}
+
+static void write_header(wav_t *wav) {
+    uint8_t h[44];
+    uint32_t block = wav->channels * wav->bits / 8;
+
+    memcpy(h, "RIFF", 4);
+    put_le(h + 4, 36 + wav->data_bytes, 4);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    put_le(h + 16, 16, 4);
+    put_le(h + 20, 1, 2);
+    put_le(h + 22, wav->channels, 2);
+    put_le(h + 24, wav->sample_rate, 4);
+    put_le(h + 28, wav->sample_rate * block, 4);
+    put_le(h + 32, block, 2);
+    put_le(h + 34, wav->bits, 2);
+    memcpy(h + 36, "data", 4);
+    put_le(h + 40, wav->data_bytes, 4);
+    fseek(wav->file, 0, SEEK_SET);
+    fwrite(h, 1, sizeof(h), wav->file);
+}
+
+bool wav_open_read(wav_t *wav, const char *path) {
+    uint8_t h[12], chunk[8], fmt[16];
+    bool have_fmt = false;
+
+    memset(wav, 0, sizeof(*wav));
+    wav->file = strcmp(path, "-") ? fopen(path, "rb") : stdin;
+    if (wav->file == NULL) return false;
+    if (fread(h, 1, 12, wav->file) != 12 || memcmp(h, "RIFF", 4) || memcmp(h + 8, "WAVE", 4)) goto fail;
+
+    while (fread(chunk, 1, 8, wav->file) == 8) {
+        uint32_t size = get_le(chunk + 4, 4);
+        if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+            if (fread(fmt, 1, 16, wav->file) != 16) goto fail;
+            //PCM or WAVE_FORMAT_EXTENSIBLE
+            if (get_le(fmt, 2) != 1 && get_le(fmt, 2) != 0xfffe) goto fail;
+            wav->channels = get_le(fmt + 2, 2);
+            wav->sample_rate = get_le(fmt + 4, 4);
+            wav->bits = get_le(fmt + 14, 2);
+            have_fmt = true;
+            size -= 16;
+        }
+        else if (memcmp(chunk, "data", 4) == 0 && have_fmt) {
+            wav->data_bytes = size;
+            return true;
+        }
+        for (uint32_t i = 0; i < size + (size & 1); i++) {
+            if (fgetc(wav->file) == EOF) goto fail;
+        }
+    }
+fail:
+    wav_close(wav);
+    return false;
+}
+
+bool wav_open_write(wav_t *wav, const char *path, uint32_t sample_rate, uint16_t channels, uint16_t bits) {
+    memset(wav, 0, sizeof(*wav));
+    wav->file = fopen(path, "wb");
+    if (wav->file == NULL) return false;
+    wav->sample_rate = sample_rate;
+    wav->channels = channels;
+    wav->bits = bits;
+    wav->writing = true;
+    write_header(wav);
+    return true;
+}
+
+size_t wav_read(wav_t *wav, void *data, size_t bytes) {
+    if (bytes > wav->data_bytes) bytes = wav->data_bytes;
+    size_t n = fread(data, 1, bytes, wav->file);
+    wav->data_bytes -= n;
+    return n;
+}
+
+size_t wav_write(wav_t *wav, const void *data, size_t bytes) {
+    size_t n = fwrite(data, 1, bytes, wav->file);
+    wav->data_bytes += n;
+    return n;
+}
+
+void wav_close(wav_t *wav) {
+    if (wav->file == NULL) return;
+    if (wav->writing) write_header(wav);
+    if (wav->file != stdin) fclose(wav->file);
+    wav->file = NULL;
+}
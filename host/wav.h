@@ -0,0 +1,31 @@
+#pragma once
+
+/* minimal PCM WAV reader and writer for the host tools */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct {
+    uint32_t sample_rate;
+    uint16_t channels;
+    uint16_t bits;
+    uint32_t data_bytes;        /*!< bytes left to read, or written so far */
+    bool writing;
+    FILE *file;
+} wav_t;
+
+/**
+ * @brief     open a PCM WAV file and position it at the start of the sample data
+ */
+bool wav_open_read(wav_t *wav, const char *path);
+
+/**
+ * @brief     create a PCM WAV file, the header is completed by wav_close
+ */
+bool wav_open_write(wav_t *wav, const char *path, uint32_t sample_rate, uint16_t channels, uint16_t bits);
+
+size_t wav_read(wav_t *wav, void *data, size_t bytes);
+size_t wav_write(wav_t *wav, const void *data, size_t bytes);
+
+void wav_close(wav_t *wav);
@@ -0,0 +1,166 @@
+/*
+ * Pushes a 16 bit stereo WAV file through the firmware sample path (main/audio_pipeline.c)
+ * in A2DP sized packets, through a ring buffer of the firmware size, and writes the 32 bit
+ * i2s output as WAV. With -g the input comes from the test signal generator (main/siggen.c).
+ *
+ *   wav_pipe [-v volume] [-m vol_min] [-p power] [-n packet_bytes] [-r ringbuf_bytes] [-d dma_bytes] in.wav out.wav
+ *   wav_pipe -g signal[,freq[,dBFS]] [-t seconds] [-f rate] [...] out.wav
+ *     -v  AVRCP volume 0..127, default 127
+ *     -m  volume curve factor at 1%, default 30
+ *     -p  volume curve exponent, default 3.0
+ *     -n  bytes per A2DP packet, default 4096
+ *     -r  ring buffer size, default RINGBUF_SIZE
+ *     -d  bytes taken from the ring buffer per i2s write, default one DMA buffer set
+ *     -g  silence, sine, sweep, pink or impulse, frequency is the sweep start or impulses per second
+ *     -t  seconds of generated signal, default 10
+ *     -f  sample rate of the generated signal, default 44100
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "freertos/ringbuf.h"
+#include "bt_app_core.h"
+#include "audio_pipeline.h"
+#include "siggen.h"
+#include "wav.h"
+
+
+static double now_s() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//the i2s task: take what is there, up to one DMA buffer set at a time
+static void drain(RingbufHandle_t ringbuf, wav_t *out, size_t dma_bytes, uint64_t *bytes_out) {
+    size_t item_size;
+    uint8_t *data;
+    while ((data = xRingbufferReceiveUpTo(ringbuf, &item_size, 0, dma_bytes)) != NULL) {
+        wav_write(out, data, item_size);
+        vRingbufferReturnItem(ringbuf, data);
+        *bytes_out += item_size;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int volume = AUDIO_VOLUME_MAX;
+    int vol_min = 30;
+    float power = 3.0;
+    size_t packet_bytes = 4096;
+    size_t ringbuf_size = RINGBUF_SIZE;
+    size_t dma_bytes = I2S_DMA_BUF_COUNT * I2S_DMA_BUF_LEN * 8;
+    bool generate = false;
+    siggen_config_t sig;
+    siggen_t gen;
+    float seconds = 10;
+    char type[16];
+    int opt;
+
+    siggen_default_config(&sig);
+    while ((opt = getopt(argc, argv, "v:m:p:n:r:d:g:t:f:")) != -1) {
+        switch (opt) {
+        case 'v': volume = atoi(optarg); break;
+        case 'm': vol_min = atoi(optarg); break;
+        case 'p': power = atof(optarg); break;
+        case 'n': packet_bytes = strtoul(optarg, NULL, 0) & ~(size_t)3; break;
+        case 'r': ringbuf_size = strtoul(optarg, NULL, 0); break;
+        case 'd': dma_bytes = strtoul(optarg, NULL, 0); break;
+        case 'g':
+            if (sscanf(optarg, "%15[a-z],%f,%f", type, &sig.freq, &sig.level_db) < 1) goto usage;
+            sig.type = siggen_type(type);
+            if (sig.type == SIGGEN_MAX) goto usage;
+            generate = true;
+            break;
+        case 't': seconds = atof(optarg); break;
+        case 'f': sig.sample_rate = strtoul(optarg, NULL, 0); break;
+        default: goto usage;
+        }
+    }
+    if (argc - optind != (generate ? 1 : 2) || volume < 0 || volume > AUDIO_VOLUME_MAX || packet_bytes == 0 ||
+        packet_bytes * 2 > ringbuf_size || dma_bytes == 0 || (generate && !siggen_config_valid(&sig))) {
+        goto usage;
+    }
+
+    wav_t in = { 0 }, out;
+    if (generate) {
+        siggen_init(&gen, &sig);
+        in.sample_rate = sig.sample_rate;
+        in.data_bytes = (uint32_t)(seconds * sig.sample_rate) * 4;
+    }
+    else if (!wav_open_read(&in, argv[optind])) {
+        fprintf(stderr, "%s: not a PCM WAV file\n", argv[optind]);
+        return 1;
+    }
+    else if (in.channels != 2 || in.bits != 16) {
+        fprintf(stderr, "%s: need 16 bit stereo, got %u bit %u channels\n", argv[optind], in.bits, in.channels);
+        return 1;
+    }
+    if (!wav_open_write(&out, argv[argc - 1], in.sample_rate, 2, 32)) {
+        perror(argv[argc - 1]);
+        return 1;
+    }
+
+    audio_volume_curve_t curve;
+    audio_pipeline_volume_curve(&curve, vol_min, power);
+    uint32_t factor = audio_pipeline_volume_factor(&curve, volume);
+    RingbufHandle_t ringbuf = xRingbufferCreate(ringbuf_size, RINGBUF_TYPE_BYTEBUF);
+    uint8_t *packet = malloc(packet_bytes);
+    uint8_t *da_data = malloc(packet_bytes * 2);
+    uint32_t level[2], peak[2] = { 0, 0 };
+    uint64_t bytes_in = 0, bytes_out = 0;
+    uint32_t packets = 0;
+    double process_s = 0;
+    size_t len;
+
+    for (;;) {
+        if (generate) {
+            len = in.data_bytes < packet_bytes ? in.data_bytes : packet_bytes;
+            siggen_fill(&gen, packet, len);
+            in.data_bytes -= len;
+        }
+        else {
+            len = wav_read(&in, packet, packet_bytes);
+        }
+        if (len == 0) break;
+
+        double t = now_s();
+        size_t da_len = audio_pipeline_process(packet, len, da_data, factor, level);
+        process_s += now_s() - t;
+
+        if (!xRingbufferSend(ringbuf, da_data, da_len, portMAX_DELAY)) {
+            drain(ringbuf, &out, dma_bytes, &bytes_out);
+            xRingbufferSend(ringbuf, da_data, da_len, portMAX_DELAY);
+        }
+        bytes_in += da_len;
+        packets++;
+        if (level[0] > peak[0]) peak[0] = level[0];
+        if (level[1] > peak[1]) peak[1] = level[1];
+    }
+    drain(ringbuf, &out, dma_bytes, &bytes_out);
+
+    double audio_s = bytes_out / 8.0 / in.sample_rate;
+    printf("volume %d -> factor %u, %u packets of %zu bytes, %.2f s audio at %u Hz\n",
+           volume, factor, packets, packet_bytes, audio_s, in.sample_rate);
+    printf("ring buffer in %llu out %llu bytes, peak left %u right %u\n",
+           (unsigned long long)bytes_in, (unsigned long long)bytes_out, peak[0], peak[1]);
+    printf("processing %.3f ms, %.1f ns per frame, %.0fx real time\n",
+           process_s * 1000, process_s * 1e9 * 8 / (bytes_out ? bytes_out : 1), process_s > 0 ? audio_s / process_s : 0);
+
+    wav_close(&in);
+    wav_close(&out);
+    vRingbufferDelete(ringbuf);
+    free(packet);
+    free(da_data);
+    return bytes_in == bytes_out ? 0 : 1;
+
+usage:
+    fprintf(stderr, "usage: %s [-v volume] [-m vol_min] [-p power] [-n packet_bytes] [-r ringbuf_bytes] [-d dma_bytes] in.wav out.wav\n"
+                    "       %s -g silence|sine|sweep|pink|impulse[,freq[,dBFS]] [-t seconds] [-f rate] [...] out.wav\n", argv[0], argv[0]);
+    return 1;
+}
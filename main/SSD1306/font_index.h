@@ -0,0 +1,22 @@
+#pragma once
+
+/* Generated from font.h by host/font_index, rewrite with font_index -u after changing the fonts. */
+
+#include <stdint.h>
+
+#define FONT_FIRST          ' '
+#define FONT_GLYPHS         95
+#define FONT2_GLYPHS        224
+
+//offset of the width byte of each font[] glyph, from FONT_FIRST on
+static const uint16_t font_offset[FONT_GLYPHS] =
+{
+      0,   2,   4,   8,  14,  20,  24,  30,  32,  35,  38,  44,
+     48,  50,  54,  56,  60,  65,  69,  74,  78,  83,  87,  92,
+     96, 101, 106, 108, 111, 115, 119, 123, 127, 133, 138, 143,
+    148, 153, 157, 161, 166, 171, 175, 179, 184, 188, 194, 200,
+    205, 210, 215, 220, 225, 229, 234, 240, 246, 252, 257, 262,
+    265, 269, 272, 276, 281, 284, 289, 294, 299, 304, 309, 312,
+    317, 322, 324, 327, 332, 334, 340, 345, 350, 355, 360, 363,
+    368, 372, 377, 383, 389, 395, 400, 404, 408, 410, 414,
+};
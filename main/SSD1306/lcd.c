@@ -8,16 +8,93 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
+#include <sys/param.h>
 #include "lcd.h"
 #include "../i2c_x.h"
 #include "font.h"
+#include "font_index.h"
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "../trace.h"
+#endif
 
 /*******************************************************************************
  * Framebuffer
+ *
+ * fb_* draw into buffer and record the columns they touch per page. fb_show copies
+ * these spans to front at a frame boundary and hands front to the flush task, drawing
+ * never waits on the bus. The flush compares only the recorded spans, copies what it
+ * sends from front to buffer_mirror, which holds what the display shows. Both copies
+ * run under the framebuffer lock, drawing code takes it around a complete update.
  */
 
+#define LCD_PAGES           (SSD1306_HEIGHT / 8)
+
+//touched columns of a page, [start, end), clean when start >= end
+typedef struct {
+    uint8_t start;
+    uint8_t end;
+} lcd_span_t;
+
 static uint8_t buffer[1024];
+static uint8_t front[1024];
 static uint8_t buffer_mirror[1024];
+static lcd_span_t dirty[LCD_PAGES];         //drawn since the last fb_show
+static lcd_span_t front_dirty[LCD_PAGES];   //presented, not yet on the display
+static volatile uint32_t presented = 0;
+static volatile uint32_t flushed = 0;
+
+#ifdef ESP_PLATFORM
+//retry period for changes left over by the bus budget when no new frame comes
+#define LCD_FLUSH_RETRY_MS  10
+
+static StaticSemaphore_t fb_mutex_buf;
+static SemaphoreHandle_t fb_mutex = NULL;
+static TaskHandle_t flush_task = NULL;
+#endif
+
+static bool lcd_flush_front();
+
+
+static inline void lcd_span_add(lcd_span_t *spans, uint8_t page, uint8_t col_start, uint8_t col_end)
+{
+    lcd_span_t *span = &spans[page];
+    if (span->start >= span->end) {
+        span->start = col_start;
+        span->end = col_end + 1;
+        return;
+    }
+    if (col_start < span->start) span->start = col_start;
+    if (col_end >= span->end) span->end = col_end + 1;
+}
+
+
+static void lcd_spans_set(lcd_span_t *spans, uint8_t start, uint8_t end)
+{
+    for (uint8_t page = 0; page < LCD_PAGES; page++) spans[page] = (lcd_span_t){ start, end };
+}
+
+#ifdef ESP_PLATFORM
+static void lcd_flush_task(void *arg)
+{
+    bool deferred = false;
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, deferred ? LCD_FLUSH_RETRY_MS / portTICK_PERIOD_MS : portMAX_DELAY);
+#if CONFIG_TRACE_ENABLE
+        int64_t flush_start_us = esp_timer_get_time();
+        deferred = lcd_flush_front();
+        TRACE(TRACE_EVT_DISPLAY_FLUSH, esp_timer_get_time() - flush_start_us);
+#else
+        deferred = lcd_flush_front();
+#endif
+    }
+}
+#endif
 
 /*******************************************************************************
  * Initialisierung des OLED-Displays
@@ -65,11 +142,29 @@ void lcd_init(void)
 
     lcd_send_command(SSD1306_NORMALDISPLAY);
 
-    fb_clear();
-    lcd_send_framebuffer(buffer);
+    //framebuffer may already be drawn by the caller, send it as it is
+    fb_lock();
+    memcpy(front, buffer, SSD1306_BUFFERSIZE);
+    lcd_spans_set(dirty, 0, 0);
+    lcd_spans_set(front_dirty, 0, 0);
+    flushed = presented;
+    fb_unlock();
+    lcd_send_framebuffer(front);
 
     //display on
     lcd_send_command(SSD1306_DISPLAYON);
+
+#ifdef ESP_PLATFORM
+    xTaskCreatePinnedToCore(
+        lcd_flush_task,         /* Task function. */
+        "LcdFlush",             /* String with name of task. */
+        2048,                   /* Stack size in bytes. */
+        NULL,                   /* Parameter passed as input of the task */
+        0,                      /* Priority of the task. */
+        &flush_task,            /* Task handle. */
+        1                       /* Core, bluetooth controller and bluedroid run on core 0 */
+    );
+#endif
 }
 
 
@@ -93,70 +188,355 @@ void lcd_invert(uint8_t inverted)
 }
 
 
-static void lcd_set_addr(uint8_t column, uint8_t page)
+/*******************************************************************************
+ * Transfers
+ *
+ * The controller runs in horizontal addressing mode: inside a column/page window the
+ * pointer wraps from the last column to the first column of the next page, so a
+ * rectangle of the framebuffer goes out as one transaction: the window commands, a
+ * repeated start and the data. A window costs the command bytes, dirty bytes closer
+ * together than that are sent along.
+ *
+ * With a bus budget set, windows touching the priority region go first, the others
+ * while the estimated bus time lasts. What does not fit stays dirty in the mirror and
+ * is sent with the next frames.
+ */
+
+//bus bytes of an extra window: address commands (addr + 0x00 + 6) and data header (addr + 0x40)
+#define LCD_WINDOW_COST     10
+//dirty runs are at least LCD_WINDOW_COST + 1 clean bytes apart
+#define LCD_MAX_WINDOWS     (LCD_PAGES * (SSD1306_WIDTH / (LCD_WINDOW_COST + 2) + 1))
+//approximate driver and interrupt time per transaction besides the bits on the bus
+#define LCD_TRANSACTION_US  30
+
+typedef struct {
+    uint8_t col_start;
+    uint8_t col_end;
+    uint8_t page_start;
+    uint8_t page_end;
+} lcd_window_t;
+
+static lcd_window_t windows[LCD_MAX_WINDOWS];
+static lcd_window_t planned[LCD_MAX_WINDOWS];
+static int planned_count = 0;
+//empty until set
+static lcd_window_t priority = { 0, 0, 1, 0 };
+static uint32_t bus_hz = 100000;
+static uint32_t bus_budget_us = 0;
+static lcd_stats_t stats;
+static uint32_t frame_transactions;
+static uint32_t frame_bytes;
+static uint32_t frame_bus_us;
+
+
+//9 clocks per byte, start and stop take about two more
+static uint32_t lcd_bus_us(uint32_t bytes, uint32_t transactions)
 {
-    lcd_send_command(SSD1306_COLUMNADDR);
-    lcd_send_command(column);
-    lcd_send_command(0x7F);
+    return (uint32_t)(((uint64_t)bytes * 9 + transactions * 2) * 1000000 / bus_hz) + transactions * LCD_TRANSACTION_US;
+}
 
-    lcd_send_command(SSD1306_PAGEADDR);
-    lcd_send_command(page);
-    lcd_send_command(0x07);
+
+static void lcd_write(const i2c_segment_t *segments, size_t count)
+{
+#ifdef ESP_PLATFORM
+    int64_t start_us = esp_timer_get_time();
+    i2c_master_write_segments(SSD1306_DEFAULT_ADDRESS, segments, count, I2C_WAIT_MS_DEFAULT);
+    frame_bus_us += esp_timer_get_time() - start_us;
+#else
+    i2c_master_write_segments(SSD1306_DEFAULT_ADDRESS, segments, count, I2C_WAIT_MS_DEFAULT);
+#endif
+    uint32_t bytes = 0;
+    for (size_t i = 0; i < count; i++) {
+        //address byte included, this is what takes bus time
+        bytes += segments[i].size + segments[i].start;
+    }
+#ifndef ESP_PLATFORM
+    frame_bus_us += lcd_bus_us(bytes, 1);
+#endif
+    frame_transactions++;
+    frame_bytes += bytes;
 }
 
 
-void lcd_send_framebuffer(uint8_t *buffer)
+//window address commands, then the data with a repeated start, straight from the mirror rows
+static void lcd_send_window(const lcd_window_t *w, const uint8_t *buffer_mirror)
 {
-    uint8_t cmd_buf[17];
-    cmd_buf[0] = 0x40;
+    static const uint8_t data_control = 0x40;
+    uint8_t width = w->col_end - w->col_start + 1;
+    uint8_t cmd_buf[7] = {
+        0x00,
+        SSD1306_COLUMNADDR, w->col_start, w->col_end,
+        SSD1306_PAGEADDR, w->page_start, w->page_end
+    };
+    i2c_segment_t segments[2 + LCD_PAGES];
+    size_t count = 0;
+
+    segments[count++] = (i2c_segment_t){ cmd_buf, sizeof(cmd_buf), true };
+    segments[count++] = (i2c_segment_t){ &data_control, 1, true };
+    for (uint8_t page = w->page_start; page <= w->page_end; page++) {
+        segments[count++] = (i2c_segment_t){ &buffer_mirror[page * SSD1306_WIDTH + w->col_start], width, false };
+    }
+    lcd_write(segments, count);
+}
 
-    lcd_set_addr(0, 0);
 
-    for (uint8_t packet = 0; packet < 64; packet++) {
-        for (uint8_t i = 0; i < 16; i++) {
-            cmd_buf[i + 1] = buffer[packet * 16 + i];
-            buffer_mirror[packet * 16 + i] = buffer[packet * 16 + i];
-        }
-        i2c_master_write_slave(SSD1306_DEFAULT_ADDRESS, &cmd_buf[0], 17, I2C_WAIT_MS_DEFAULT);
+//the window goes into the mirror now and on the bus with the next lcd_send_planned
+static void lcd_plan_window(const lcd_window_t *w, const uint8_t *buffer, uint8_t *buffer_mirror)
+{
+    uint8_t width = w->col_end - w->col_start + 1;
+    for (uint8_t page = w->page_start; page <= w->page_end; page++) {
+        uint16_t offset = page * SSD1306_WIDTH + w->col_start;
+        memcpy(&buffer_mirror[offset], &buffer[offset], width);
     }
+    planned[planned_count++] = *w;
 }
 
 
-void lcd_update_framebuffer(uint8_t *buffer, uint8_t *buffer_mirror)
+static uint32_t lcd_window_us(const lcd_window_t *w, uint8_t pages)
+{
+    return lcd_bus_us(LCD_WINDOW_COST + (w->col_end - w->col_start + 1) * pages, 1);
+}
+
+
+static bool lcd_window_priority(const lcd_window_t *w)
+{
+    return w->col_start <= priority.col_end && w->col_end >= priority.col_start &&
+           w->page_start <= priority.page_end && w->page_end >= priority.page_start;
+}
+
+
+static void lcd_frame_done()
+{
+    if (frame_transactions) {
+        stats.frames++;
+        stats.frame_transactions = frame_transactions;
+        stats.frame_bytes = frame_bytes;
+        stats.frame_bus_us = frame_bus_us;
+        stats.transactions += frame_transactions;
+        stats.bytes += frame_bytes;
+        stats.bus_us += frame_bus_us;
+    }
+    frame_transactions = 0;
+    frame_bytes = 0;
+    frame_bus_us = 0;
+}
+
+
+static void lcd_send_planned(const uint8_t *buffer_mirror)
 {
-    uint8_t start_column = 0;
-    uint8_t start_page = 0;
-    uint8_t cmd_buf[17];
-    bool chunk_changed = false;
-    bool address_sent = false;
-    bool address_sent_zero = false;
-    cmd_buf[0] = 0x40;
-
-    for (uint8_t packet = 0; packet < 64; packet++) {
-        start_page = packet >> 3;
-        for (uint8_t i = 0; i < 16; i++) {
-            cmd_buf[i + 1] = buffer[packet * 16 + i];
-            if (buffer_mirror[packet * 16 + i] != buffer[packet * 16 + i]) {
-                chunk_changed = true;
-                buffer_mirror[packet * 16 + i] = buffer[packet * 16 + i];
+    for (int i = 0; i < planned_count; i++) lcd_send_window(&planned[i], buffer_mirror);
+    planned_count = 0;
+    lcd_frame_done();
+}
+
+
+//dirty rectangles inside the touched spans of the frame, in page order
+static int lcd_collect_windows(const uint8_t *buffer, const uint8_t *buffer_mirror, const lcd_span_t *spans)
+{
+    lcd_window_t runs[SSD1306_WIDTH / (LCD_WINDOW_COST + 2) + 1];
+    int n = 0;
+
+    for (uint8_t page = 0; page < LCD_PAGES; page++) {
+        uint8_t start = spans[page].start, end = spans[page].end;
+        const uint8_t *row = &buffer[page * SSD1306_WIDTH];
+        const uint8_t *mirror = &buffer_mirror[page * SSD1306_WIDTH];
+        int count = 0;
+        if (start >= end || memcmp(&row[start], &mirror[start], end - start) == 0) continue;
+
+        //dirty runs of this page, gaps cheaper than a new window are merged
+        for (uint8_t col = start; col < end; col++) {
+            if (row[col] == mirror[col]) continue;
+            if (count && col - runs[count - 1].col_end <= LCD_WINDOW_COST) {
+                runs[count - 1].col_end = col;
+            }
+            else {
+                runs[count++] = (lcd_window_t){ col, col, page, page };
             }
         }
-        if (chunk_changed) {
-            if (address_sent == false) {
-                address_sent = true;
-                if (packet % 8 == 0) address_sent_zero = true;
-                lcd_set_addr(start_column, start_page);
+
+        //a single run may extend the window of the page above into a rectangle
+        if (n && count == 1 && windows[n - 1].page_end == page - 1) {
+            lcd_window_t *win = &windows[n - 1];
+            uint8_t col_start = MIN(win->col_start, runs[0].col_start);
+            uint8_t col_end = MAX(win->col_end, runs[0].col_end);
+            uint32_t area = (uint32_t)(win->col_end - win->col_start + 1) * (win->page_end - win->page_start + 1);
+            uint32_t merged = (uint32_t)(col_end - col_start + 1) * (page - win->page_start + 1);
+            if (merged <= area + (runs[0].col_end - runs[0].col_start + 1) + LCD_WINDOW_COST) {
+                win->col_start = col_start;
+                win->col_end = col_end;
+                win->page_end = page;
+                continue;
             }
-            if (packet % 8 == 0 && !address_sent_zero) {
-                lcd_set_addr(start_column, start_page);
+        }
+        for (int i = 0; i < count; i++) windows[n++] = runs[i];
+    }
+    return n;
+}
+
+
+void lcd_set_bus(uint32_t freq_hz, uint32_t budget_us)
+{
+    bus_hz = freq_hz;
+    bus_budget_us = budget_us;
+}
+
+
+void lcd_set_priority_region(uint8_t col_start, uint8_t col_end, uint8_t page_start, uint8_t page_end)
+{
+    priority = (lcd_window_t){ col_start, col_end, page_start, page_end };
+}
+
+
+void lcd_send_framebuffer(uint8_t *buffer)
+{
+    lcd_window_t all = { 0, SSD1306_WIDTH - 1, 0, LCD_PAGES - 1 };
+    lcd_plan_window(&all, buffer, buffer_mirror);
+    lcd_send_planned(buffer_mirror);
+}
+
+
+//picks the windows of this frame and updates the mirror, spans keep what was left for later
+static bool lcd_plan_frame(const uint8_t *buffer, uint8_t *buffer_mirror, lcd_span_t *spans)
+{
+    int n = lcd_collect_windows(buffer, buffer_mirror, spans);
+    uint32_t used_us = 0;
+    bool progressed = false;
+    bool deferred = false;
+
+    lcd_spans_set(spans, 0, 0);
+    if (bus_budget_us == 0) {
+        for (int i = 0; i < n; i++) lcd_plan_window(&windows[i], buffer, buffer_mirror);
+        return false;
+    }
+
+    for (int i = 0; i < n; i++) {
+        if (!lcd_window_priority(&windows[i])) continue;
+        lcd_plan_window(&windows[i], buffer, buffer_mirror);
+        used_us += lcd_window_us(&windows[i], windows[i].page_end - windows[i].page_start + 1);
+    }
+    for (int i = 0; i < n; i++) {
+        lcd_window_t w = windows[i];
+        if (lcd_window_priority(&w)) continue;
+
+        //as many pages of the window as fit, at least one per frame so large updates progress
+        uint8_t pages = w.page_end - w.page_start + 1;
+        while (pages && used_us + lcd_window_us(&w, pages) > bus_budget_us) pages--;
+        if (pages == 0 && !progressed) pages = 1;
+        if (pages < w.page_end - w.page_start + 1) {
+            for (uint8_t page = w.page_start + pages; page <= w.page_end; page++) {
+                lcd_span_add(spans, page, w.col_start, w.col_end);
             }
-            i2c_master_write_slave(SSD1306_DEFAULT_ADDRESS, &cmd_buf[0], 17, I2C_WAIT_MS_DEFAULT);
+            stats.deferred++;
+            deferred = true;
+        }
+        if (pages == 0) continue;
+        w.page_end = w.page_start + pages - 1;
+        lcd_plan_window(&w, buffer, buffer_mirror);
+        used_us += lcd_window_us(&w, pages);
+        progressed = true;
+    }
+    return deferred;
+}
+
+
+void lcd_update_framebuffer(uint8_t *buffer, uint8_t *buffer_mirror)
+{
+    lcd_span_t all[LCD_PAGES];
+    lcd_spans_set(all, 0, SSD1306_WIDTH);
+    lcd_plan_frame(buffer, buffer_mirror, all);
+    lcd_send_planned(buffer_mirror);
+}
+
+
+//one flush of the presented frame: planning under the lock, the bus transfer without it
+static bool lcd_flush_front()
+{
+    fb_lock();
+    uint32_t frame = presented;
+    bool deferred = lcd_plan_frame(front, buffer_mirror, front_dirty);
+    fb_unlock();
+    lcd_send_planned(buffer_mirror);
+    if (!deferred) flushed = frame;
+    return deferred;
+}
+
+
+void lcd_flush_wait()
+{
+#ifdef ESP_PLATFORM
+    while (flushed != presented) vTaskDelay(1);
+#endif
+}
+
+
+void lcd_get_stats(lcd_stats_t *s)
+{
+    *s = stats;
+}
+
+
+//bits of a page byte from row y & 7 downwards, and from the top down to row y & 7
+static const uint8_t fb_mask_from[8] = { 0xff, 0xfe, 0xfc, 0xf8, 0xf0, 0xe0, 0xc0, 0x80 };
+static const uint8_t fb_mask_to[8] = { 0x01, 0x03, 0x07, 0x0f, 0x1f, 0x3f, 0x7f, 0xff };
+
+
+//fills or clears the on screen area x0 .. x1, y0 .. y1 a page byte at a time
+static void fb_fill_area(uint8_t x0, uint8_t x1, uint8_t y0, uint8_t y1, uint8_t pixel_status)
+{
+    uint8_t width = x1 - x0 + 1;
+
+    for (uint8_t page = y0 / 8; page <= y1 / 8; page++) {
+        uint8_t mask = 0xff;
+        if (page == y0 / 8) mask &= fb_mask_from[y0 & 7];
+        if (page == y1 / 8) mask &= fb_mask_to[y1 & 7];
+
+        uint8_t *dst = &buffer[page * SSD1306_WIDTH + x0];
+        if (mask == 0xff) {
+            memset(dst, pixel_status ? 0xff : 0x00, width);
+        }
+        else if (pixel_status) {
+            for (uint8_t i = 0; i < width; i++) dst[i] |= mask;
         }
         else {
-            address_sent = false;
-            address_sent_zero = false;
+            for (uint8_t i = 0; i < width; i++) dst[i] &= ~mask;
+        }
+        lcd_span_add(dirty, page, x0, x1);
+    }
+}
+
+
+//splits start .. start + length - 1 into the on screen parts, the uint8_t coordinates wrap around to 0
+static uint8_t fb_clip(uint8_t start, uint16_t length, uint8_t limit, uint8_t range[2][2])
+{
+    uint16_t end = start + MIN(length, 0x100);
+    uint8_t n = 0;
+
+    if (end > 0x100) {
+        range[n][0] = 0;
+        range[n][1] = MIN(end - 0x100, limit) - 1;
+        n++;
+        end = 0x100;
+    }
+    if (start < limit && end > start) {
+        range[n][0] = start;
+        range[n][1] = MIN(end, limit) - 1;
+        n++;
+    }
+    return n;
+}
+
+
+//fills or clears width x height pixels from x, y, the same pixels the per pixel loops reached
+static void fb_fill_rect(uint8_t x, uint8_t y, uint16_t width, uint16_t height, uint8_t pixel_status)
+{
+    uint8_t cols[2][2], rows[2][2];
+    uint8_t n_cols = fb_clip(x, width, SSD1306_WIDTH, cols);
+    uint8_t n_rows = fb_clip(y, height, SSD1306_HEIGHT, rows);
+
+    for (uint8_t c = 0; c < n_cols; c++) {
+        for (uint8_t r = 0; r < n_rows; r++) {
+            fb_fill_area(cols[c][0], cols[c][1], rows[r][0], rows[r][1], pixel_status);
         }
-        start_column = (start_column + 16) % 128;
     }
 }
 
@@ -173,22 +553,19 @@ void fb_draw_pixel(uint8_t pos_x, uint8_t pos_y, uint8_t pixel_status)
     else {
         buffer[pos_x + (pos_y / 8) * SSD1306_WIDTH] &= ~(1 << (pos_y & 7));
     }
+    lcd_span_add(dirty, pos_y / 8, pos_x, pos_x);
 }
 
 
 void fb_draw_v_line(uint8_t x, uint8_t y, uint8_t length)
 {
-    for (uint8_t i = 0; i < length; ++i) {
-        fb_draw_pixel(x, i + y, 1);
-    }
+    fb_fill_rect(x, y, 1, length, 1);
 }
 
 
 void fb_draw_h_line(uint8_t x, uint8_t y, uint8_t length)
 {
-    for (uint8_t i = 0; i < length; ++i) {
-        fb_draw_pixel(i + x, y, 1);
-    }
+    fb_fill_rect(x, y, length, 1, 1);
 }
 
 
@@ -204,11 +581,7 @@ void fb_draw_rectangle(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint8_t f
         fb_draw_v_line(x2, y1, height);
     }
     else {
-        for (uint8_t x = 0; x < length; ++x) {
-            for (uint8_t y = 0; y <= height; ++y) {
-                fb_draw_pixel(x1 + x, y + y1, 1);
-            }
-        }
+        fb_fill_rect(x1, y1, length, height + 1, 1);
     }
 }
 
@@ -217,10 +590,38 @@ void fb_clear_rectangle(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2)
     uint8_t length = x2 - x1 + 1;
     uint8_t height = y2 - y1;
 
-    for (uint8_t x = 0; x < length; ++x) {
-        for (uint8_t y = 0; y <= height; ++y) {
-            fb_draw_pixel(x1 + x, y + y1, 0);
+    fb_fill_rect(x1, y1, length, height + 1, 0);
+}
+
+
+void fb_draw_bitmap(uint8_t x, uint8_t y, const uint8_t *bitmap, uint8_t width, uint8_t height)
+{
+    uint8_t shift = y & 7;
+
+    if (x >= SSD1306_WIDTH || y >= SSD1306_HEIGHT || width == 0 || height == 0) return;
+    uint8_t columns = MIN(width, SSD1306_WIDTH - x);
+    uint16_t y_end = MIN(y + height, SSD1306_HEIGHT) - 1;
+
+    for (uint8_t band = 0; band < (height + 7) / 8; band++) {
+        uint8_t page = y / 8 + band;
+        if (page > y_end / 8) break;
+
+        //rows of this band inside the bitmap and on screen, moved down into the page and the next one
+        uint8_t rows = fb_mask_to[MIN(height - band * 8, 8) - 1];
+        uint16_t mask = rows << shift;
+        uint16_t last = y_end - page * 8;
+        if (last < 16) mask &= (2u << last) - 1;
+
+        const uint8_t *src = &bitmap[band * width];
+        uint8_t *dst = &buffer[page * SSD1306_WIDTH + x];
+        uint8_t mask_lo = mask, mask_hi = mask >> 8;
+        for (uint8_t i = 0; i < columns; i++) {
+            uint16_t bits = src[i] << shift;
+            dst[i] = (dst[i] & ~mask_lo) | (bits & mask_lo);
+            if (mask_hi) dst[i + SSD1306_WIDTH] = (dst[i + SSD1306_WIDTH] & ~mask_hi) | ((bits >> 8) & mask_hi);
         }
+        lcd_span_add(dirty, page, x, x + columns - 1);
+        if (mask_hi) lcd_span_add(dirty, page + 1, x, x + columns - 1);
     }
 }
 
@@ -242,6 +643,7 @@ void fb_clear()
     for (uint16_t i = 0; i < SSD1306_BUFFERSIZE; i++) {
         buffer[i] = 0;
     }
+    lcd_spans_set(dirty, 0, SSD1306_WIDTH);
 }
 
 
@@ -251,41 +653,112 @@ void fb_invert(uint8_t status)
 }
 
 
+uint8_t *fb_buffer()
+{
+    return buffer;
+}
+
+
+void fb_init()
+{
+#ifdef ESP_PLATFORM
+    fb_mutex = xSemaphoreCreateMutexStatic(&fb_mutex_buf);
+#endif
+}
+
+
+void fb_lock()
+{
+#ifdef ESP_PLATFORM
+    xSemaphoreTake(fb_mutex, portMAX_DELAY);
+#endif
+}
+
+
+void fb_unlock()
+{
+#ifdef ESP_PLATFORM
+    xSemaphoreGive(fb_mutex);
+#endif
+}
+
+
+void fb_invalidate()
+{
+    lcd_spans_set(dirty, 0, SSD1306_WIDTH);
+}
+
+
 void fb_show()
 {
-    lcd_update_framebuffer(buffer, buffer_mirror);
+    fb_lock();
+    for (uint8_t page = 0; page < LCD_PAGES; page++) {
+        lcd_span_t span = dirty[page];
+        if (span.start >= span.end) continue;
+        memcpy(&front[page * SSD1306_WIDTH + span.start], &buffer[page * SSD1306_WIDTH + span.start], span.end - span.start);
+        lcd_span_add(front_dirty, page, span.start, span.end - 1);
+        dirty[page] = (lcd_span_t){ 0, 0 };
+    }
+    presented++;
+    fb_unlock();
+#ifdef ESP_PLATFORM
+    if (flush_task) xTaskNotifyGive(flush_task);
+#else
+    lcd_flush_front();
+#endif
 }
 
 void fb_show_bmp(uint8_t *pBmp)
 {
-    lcd_update_framebuffer(pBmp, buffer_mirror);
+    fb_lock();
+    memcpy(buffer, pBmp, SSD1306_BUFFERSIZE);
+    fb_invalidate();
+    fb_unlock();
+    fb_show();
 }
 
 
-void fb_draw_char (uint16_t x, uint16_t y, uint16_t fIndex)
+//glyph of c as width byte and columns, characters outside the font are drawn as space
+static inline const uint8_t *fb_glyph(char c)
 {
-    uint16_t bufIndex = (y << 7) + x;
+    uint8_t g = (uint8_t)c - FONT_FIRST;
+    return &font[font_offset[g < FONT_GLYPHS ? g : 0]];
+}
 
-    for(uint8_t j = 0; j < FONT_WIDTH; j++) {
-        buffer[bufIndex + j] = font[fIndex + j + 1];
-    }
+
+static inline const uint8_t *fb_glyph_big(char c)
+{
+    uint8_t g = (uint8_t)c - FONT_FIRST;
+    return font2[g < FONT2_GLYPHS ? g : 0];
+}
+
+
+//copies columns into one page, clipped at the right edge
+static void fb_put_columns(uint16_t x, uint16_t y, const uint8_t *columns, uint8_t width)
+{
+    if (x >= SSD1306_WIDTH || y >= LCD_PAGES || width == 0) return;
+    width = MIN(width, SSD1306_WIDTH - x);
+    memcpy(&buffer[(y << 7) + x], columns, width);
+    lcd_span_add(dirty, y, x, x + width - 1);
+}
+
+
+void fb_draw_char (uint16_t x, uint16_t y, uint16_t fIndex)
+{
+    fb_put_columns(x, y, &font[fIndex + 1], FONT_WIDTH);
 }
 
 
 void fb_draw_string (uint16_t x, uint16_t y, const char *s)
 {
-    while(*s) {
-        /* index the width information of character <c> */
-        uint16_t lIndex = 0;
-        for(uint16_t k = 0; k < (*s - ' '); k++) {
-            lIndex += (font[lIndex]) + 1;
-        }
+    while (*s && x < SSD1306_WIDTH) {
+        const uint8_t *glyph = fb_glyph(*s);
 
-        /* draw character */
-        fb_draw_char(x, y, lIndex);
+        /* draw character, the column after it is left as it is */
+        fb_put_columns(x, y, glyph + 1, glyph[0]);
 
         /* move the cursor forward for the next character */
-        x += font[lIndex] + 1;
+        x += glyph[0] + 1;
 
         /* next charachter */
         s++;
@@ -294,15 +767,59 @@ void fb_draw_string (uint16_t x, uint16_t y, const char *s)
 
 void fb_draw_string_big (uint16_t x, uint16_t y, const char *s)
 {
-    while(*s) {
-        for(uint8_t k = 0; k < 10; k++) {
-            buffer[( y    << 7) + x + k] = font2[*s - ' '][k * 2  ];
-            buffer[((y+1) << 7) + x + k] = font2[*s - ' '][k * 2 + 1];
+    uint16_t x_start = x;
+
+    if (y >= LCD_PAGES) return;
+    while (*s && x < SSD1306_WIDTH) {
+        const uint8_t *glyph = fb_glyph_big(*s);
+        uint8_t width = MIN(10, SSD1306_WIDTH - x);
+
+        for (uint8_t k = 0; k < width; k++) {
+            buffer[( y    << 7) + x + k] = glyph[k * 2];
+            if (y + 1 < LCD_PAGES) buffer[((y+1) << 7) + x + k] = glyph[k * 2 + 1];
         }
 
-        x += 10;
+        x += width;
 
         /* next charachter */
         s++;
     }
+    if (x == x_start) return;
+    lcd_span_add(dirty, y, x_start, x - 1);
+    if (y + 1 < LCD_PAGES) lcd_span_add(dirty, y + 1, x_start, x - 1);
+}
+
+
+void fb_draw_text(fb_text_t *cache, uint16_t x, uint16_t y, const char *s, bool big)
+{
+    size_t len = strlen(s);
+
+    if (!cache->cached || cache->big != big || strcmp(cache->text, s) != 0) {
+        uint8_t width = 0;
+
+        memset(cache->columns, 0, sizeof(cache->columns));
+        for (const char *c = s; *c && width < SSD1306_WIDTH; c++) {
+            if (big) {
+                const uint8_t *glyph = fb_glyph_big(*c);
+                for (uint8_t k = 0; k < 10 && width < SSD1306_WIDTH; k++, width++) {
+                    cache->columns[0][width] = glyph[k * 2];
+                    cache->columns[1][width] = glyph[k * 2 + 1];
+                }
+            }
+            else {
+                const uint8_t *glyph = fb_glyph(*c);
+                uint8_t columns = MIN(glyph[0], SSD1306_WIDTH - width);
+                memcpy(&cache->columns[0][width], glyph + 1, columns);
+                width = MIN(width + glyph[0] + 1, SSD1306_WIDTH);
+            }
+        }
+        cache->width = width;
+        cache->big = big;
+        //longer texts are rendered every time
+        cache->cached = len < sizeof(cache->text);
+        if (cache->cached) memcpy(cache->text, s, len + 1);
+    }
+
+    fb_put_columns(x, y, cache->columns[0], cache->width);
+    if (big) fb_put_columns(x, y + 1, cache->columns[1], cache->width);
 }
@@ -9,6 +9,7 @@
  ******************************************************************************/
 
 #include <stdint.h>
+#include <stdbool.h>
 
 /*******************************************************************************
  * Makros
@@ -46,24 +47,72 @@
 
 #define SSD1306_BUFFERSIZE (SSD1306_WIDTH*SSD1306_HEIGHT)/8
 
+/*******************************************************************************
+ * I2C traffic of the framebuffer transfers, bytes include the address byte. Bus time is
+ * measured on the target and estimated from the bus frequency on the host.
+ */
+
+typedef struct {
+    uint32_t frames;                //transfers that sent anything
+    uint32_t frame_transactions;    //of the last such transfer
+    uint32_t frame_bytes;
+    uint32_t frame_bus_us;
+    uint32_t deferred;              //windows postponed to a later frame by the bus budget
+    uint64_t transactions;
+    uint64_t bytes;
+    uint64_t bus_us;
+} lcd_stats_t;
+
 
 void lcd_init(void);
 void lcd_send_framebuffer(uint8_t *buffer);
+void lcd_update_framebuffer(uint8_t *buffer, uint8_t *buffer_mirror);
 void lcd_invert(uint8_t inverted);
 void lcd_send_command(uint8_t command);
 void lcd_send_data(uint8_t data);
+void lcd_get_stats(lcd_stats_t *s);
+void lcd_set_bus(uint32_t freq_hz, uint32_t budget_us);
+void lcd_set_priority_region(uint8_t col_start, uint8_t col_end, uint8_t page_start, uint8_t page_end);
+void lcd_flush_wait();
+
+/*******************************************************************************
+ * fb_show presents the framebuffer at a frame boundary, the flush task sends it in
+ * the background. Callers drawing from more than one task hold fb_lock around a
+ * complete update so a frame never shows it half drawn.
+ */
+
+#define FB_TEXT_LEN         32
+
+//text rendered once into display columns and copied a page at a time while it stays the same, zero initialized
+typedef struct {
+    uint8_t columns[2][SSD1306_WIDTH];
+    char text[FB_TEXT_LEN];
+    uint8_t width;
+    bool big;
+    bool cached;
+} fb_text_t;
+
+void fb_init();
+void fb_lock();
+void fb_unlock();
+//after writing through fb_buffer(), which the dirty tracking does not see
+void fb_invalidate();
 
 void fb_draw_pixel(uint8_t pos_x, uint8_t pos_y, uint8_t pixel_status);
 void fb_draw_v_line(uint8_t x, uint8_t y, uint8_t length);
 void fb_draw_h_line(uint8_t x, uint8_t y, uint8_t length);
 void fb_draw_rectangle(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint8_t fill);
 void fb_clear_rectangle(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2);
+//1bpp bitmap in display layout, rows of 8 pixels per byte (bit 0 on top) and width bytes per 8 rows
+void fb_draw_bitmap(uint8_t x, uint8_t y, const uint8_t *bitmap, uint8_t width, uint8_t height);
 void fb_clear();
 void fb_clear_line(uint8_t line);
 void fb_clear_line_part(uint8_t line, uint8_t start_x, uint8_t end_x);
 void fb_invert(uint8_t status);
 void fb_show();
+uint8_t *fb_buffer();
 void fb_show_bmp(uint8_t *pBmp);
 void fb_draw_char (uint16_t x, uint16_t y, uint16_t fIndex);
 void fb_draw_string (uint16_t x, uint16_t y, const char *s);
 void fb_draw_string_big (uint16_t x, uint16_t y, const char *s);
+void fb_draw_text(fb_text_t *cache, uint16_t x, uint16_t y, const char *s, bool big);
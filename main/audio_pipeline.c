@@ -0,0 +1,94 @@
+#include <string.h>
+#include <math.h>
+
+#include "audio_pipeline.h"
+
+
+void audio_pipeline_volume_curve(audio_volume_curve_t *curve, uint16_t vol_min, float power) {
+    curve->power = power;
+    curve->pow_min = pow(vol_min, (1.0 / power));
+    curve->pow_diff = pow(AUDIO_VOLUME_FACTOR_MAX, (1.0 / power)) - curve->pow_min;
+}
+
+uint8_t audio_pipeline_volume_pct(uint8_t vol) {
+    return (uint32_t)vol * 100 / AUDIO_VOLUME_MAX;
+}
+
+//calculate volume with power function
+uint32_t audio_pipeline_volume_factor(const audio_volume_curve_t *curve, uint8_t vol) {
+    if (vol == 0) return 0;
+    if (vol == AUDIO_VOLUME_MAX) return AUDIO_VOLUME_FACTOR_MAX;
+
+    return floor(pow((curve->pow_min + curve->pow_diff / 100 * audio_pipeline_volume_pct(vol)), curve->power));
+}
+
+//byte by byte, independent of the cpu byte order
+static size_t process_bytes(const uint8_t *in, size_t len, uint8_t *out, uint32_t volume, uint32_t level[2]) {
+    uint8_t lr = 0;
+
+    level[0] = 0;
+    level[1] = 0;
+    len &= ~(size_t)1;
+    for (size_t i = 0; i < len; i += 2) {
+        int16_t sample = (int16_t)(in[i] | in[i + 1] << 8);
+
+        //apply volume, full scale 16 bit times 65536 still fits
+        int32_t da_sample = (int32_t)volume * sample;
+        uint32_t magnitude = da_sample < 0 ? 0u - (uint32_t)da_sample : (uint32_t)da_sample;
+        if (magnitude > level[lr]) level[lr] = magnitude;
+
+        out[2 * i] = (uint8_t)da_sample;
+        out[2 * i + 1] = (uint8_t)(da_sample >> 8);
+        out[2 * i + 2] = (uint8_t)(da_sample >> 16);
+        out[2 * i + 3] = (uint8_t)(da_sample >> 24);
+        lr ^= 1;
+    }
+    return len << 1;
+}
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+static inline uint32_t magnitude(int32_t v) {
+    return v < 0 ? 0u - (uint32_t)v : (uint32_t)v;
+}
+
+//whole stereo frames as words, the input from bluedroid is not necessarily aligned
+static size_t process_frames(const uint8_t *in, size_t len, uint8_t *out, uint32_t volume, uint32_t level[2]) {
+    uint32_t peak_l = 0, peak_r = 0;
+    size_t frames = len >> 2;
+
+    for (size_t f = 0; f < frames; f++) {
+        int16_t pcm[2];
+        int32_t da[2];
+        memcpy(pcm, in + 4 * f, 4);
+        da[0] = (int32_t)volume * pcm[0];
+        da[1] = (int32_t)volume * pcm[1];
+        uint32_t m_l = magnitude(da[0]), m_r = magnitude(da[1]);
+        peak_l = m_l > peak_l ? m_l : peak_l;
+        peak_r = m_r > peak_r ? m_r : peak_r;
+        memcpy(out + 8 * f, da, 8);
+    }
+    //a trailing left sample of an odd packet
+    if (len & 2) {
+        int16_t pcm;
+        memcpy(&pcm, in + 4 * frames, 2);
+        int32_t da = (int32_t)volume * pcm;
+        peak_l = magnitude(da) > peak_l ? magnitude(da) : peak_l;
+        memcpy(out + 8 * frames, &da, 4);
+    }
+    level[0] = peak_l;
+    level[1] = peak_r;
+    return (len & ~(size_t)1) << 1;
+}
+#endif
+
+const audio_pipeline_kernel_info_t audio_pipeline_kernels[] = {
+    { "bytes", process_bytes },
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    { "frames", process_frames },
+#endif
+};
+const int audio_pipeline_kernel_count = sizeof(audio_pipeline_kernels) / sizeof(audio_pipeline_kernels[0]);
+
+size_t audio_pipeline_process(const uint8_t *in, size_t len, uint8_t *out, uint32_t volume, uint32_t level[2]) {
+    return audio_pipeline_kernels[audio_pipeline_kernel_count - 1].process(in, len, out, volume, level);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+
+/*
+ * Hardware independent part of the sample path: 16 bit PCM from the A2DP decoder to
+ * 32 bit i2s samples with volume applied, peak levels for the VU meter and the volume
+ * curve. No FreeRTOS or ESP-IDF dependencies, the same code runs in the host build.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define AUDIO_VOLUME_MAX        0x7f                /*!< AVRCP absolute volume range */
+#define AUDIO_VOLUME_FACTOR_MAX 65536               /*!< volume factor at full volume, 16 bit -> 32 bit */
+
+/* power function volume curve, factor vol_min at 1% up to AUDIO_VOLUME_FACTOR_MAX at 100% */
+typedef struct {
+    float power;
+    float pow_min;
+    float pow_diff;
+} audio_volume_curve_t;
+
+/**
+ * @brief     calculate the curve constants
+ */
+void audio_pipeline_volume_curve(audio_volume_curve_t *curve, uint16_t vol_min, float power);
+
+/**
+ * @brief     volume factor for an AVRCP volume 0..0x7f
+ */
+uint32_t audio_pipeline_volume_factor(const audio_volume_curve_t *curve, uint8_t vol);
+
+/**
+ * @brief     AVRCP volume 0..0x7f in percent
+ */
+uint8_t audio_pipeline_volume_pct(uint8_t vol);
+
+/* a sample path kernel, same contract as audio_pipeline_process */
+typedef size_t (*audio_pipeline_kernel_t)(const uint8_t *in, size_t len, uint8_t *out, uint32_t volume, uint32_t level[2]);
+
+typedef struct {
+    const char *name;
+    audio_pipeline_kernel_t process;
+} audio_pipeline_kernel_info_t;
+
+/* all implementations, they must produce bit identical output, the first is the reference */
+extern const audio_pipeline_kernel_info_t audio_pipeline_kernels[];
+extern const int audio_pipeline_kernel_count;
+
+/**
+ * @brief     convert interleaved 16 bit stereo to 32 bit samples scaled by volume
+ *
+ * Runs the fastest of audio_pipeline_kernels for this platform.
+ *
+ * @param[in]  in       little endian 16 bit samples, len bytes
+ * @param[out] out      little endian 32 bit samples, 2 * len bytes
+ * @param[out] level    peak magnitude of the left and right channel
+ *
+ * @return    bytes written to out
+ */
+size_t audio_pipeline_process(const uint8_t *in, size_t len, uint8_t *out, uint32_t volume, uint32_t level[2]);
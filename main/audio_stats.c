@@ -0,0 +1,159 @@
+#include <string.h>
+#include <stdio.h>
+
+#include "audio_stats.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_log.h"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-variable"
+static const char *TAG = "AUDIO_STATS";
+#pragma GCC diagnostic pop
+
+#define STATS_PRINT(fmt, ...)   ESP_LOGI(TAG, fmt, ##__VA_ARGS__)
+#else
+#define STATS_PRINT(fmt, ...)   printf(fmt "\n", ##__VA_ARGS__)
+#endif
+
+
+typedef struct {
+    bool active;
+    int64_t start_us;
+    int64_t last_pkt_us;
+    uint32_t packets;
+    uint64_t bytes;
+    uint32_t underruns;
+    uint32_t overflows;
+    uint32_t dropped_bytes;
+    uint64_t i2s_blocked_us;
+    uint32_t i2s_blocked_max_us;
+    uint32_t cb_latency_max_us;
+    uint32_t size_hist[AUDIO_STATS_SIZE_BUCKETS];
+    uint32_t interval_hist[AUDIO_STATS_INTERVAL_BUCKETS];
+} session_t;
+
+typedef struct {
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t samples;
+} window_t;
+
+static session_t session;
+static window_t window;
+
+
+static void window_reset() {
+    window.min = UINT32_MAX;
+    window.max = 0;
+    window.sum = 0;
+    window.samples = 0;
+}
+
+void audio_stats_session_start(int64_t now_us) {
+    memset(&session, 0, sizeof(session));
+    window_reset();
+    session.start_us = now_us;
+    session.active = true;
+}
+
+void audio_stats_session_stop() {
+    session.active = false;
+}
+
+void audio_stats_packet(uint32_t len, int64_t now_us) {
+    uint32_t b = len / AUDIO_STATS_SIZE_STEP;
+    session.size_hist[b < AUDIO_STATS_SIZE_BUCKETS ? b : AUDIO_STATS_SIZE_BUCKETS - 1]++;
+    if (session.packets) {
+        b = (now_us - session.last_pkt_us) / AUDIO_STATS_INTERVAL_STEP_US;
+        session.interval_hist[b < AUDIO_STATS_INTERVAL_BUCKETS ? b : AUDIO_STATS_INTERVAL_BUCKETS - 1]++;
+    }
+    session.last_pkt_us = now_us;
+    session.packets++;
+    session.bytes += len;
+}
+
+void audio_stats_ring_fill(uint32_t fill) {
+    if (fill < window.min) window.min = fill;
+    if (fill > window.max) window.max = fill;
+    window.sum += fill;
+    window.samples++;
+}
+
+void audio_stats_overflow() {
+    session.overflows++;
+}
+
+void audio_stats_dropped(uint32_t bytes) {
+    session.dropped_bytes += bytes;
+}
+
+void audio_stats_underrun() {
+    if (session.active) session.underruns++;
+}
+
+void audio_stats_i2s_blocked(uint32_t us) {
+    session.i2s_blocked_us += us;
+    if (us > session.i2s_blocked_max_us) session.i2s_blocked_max_us = us;
+}
+
+void audio_stats_cb_latency(uint32_t us) {
+    if (us > session.cb_latency_max_us) session.cb_latency_max_us = us;
+}
+
+bool audio_stats_active() {
+    return session.active;
+}
+
+uint32_t audio_stats_underruns() {
+    return session.underruns;
+}
+
+uint32_t audio_stats_cb_latency_max() {
+    return session.cb_latency_max_us;
+}
+
+void audio_stats_snapshot(audio_stats_snapshot_t *s, int64_t now_us) {
+    s->active = session.active;
+    s->session_ms = session.start_us ? (now_us - session.start_us) / 1000 : 0;
+    s->packets = session.packets;
+    s->bytes = session.bytes;
+    s->underruns = session.underruns;
+    s->overflows = session.overflows;
+    s->dropped_bytes = session.dropped_bytes;
+    s->i2s_blocked_us = session.i2s_blocked_us;
+    s->i2s_blocked_max_us = session.i2s_blocked_max_us;
+    s->cb_latency_max_us = session.cb_latency_max_us;
+    memcpy(s->size_hist, session.size_hist, sizeof(s->size_hist));
+    memcpy(s->interval_hist, session.interval_hist, sizeof(s->interval_hist));
+
+    s->fill_min = window.samples ? window.min : 0;
+    s->fill_max = window.max;
+    s->fill_avg = window.samples ? window.sum / window.samples : 0;
+    window_reset();
+}
+
+static void print_hist(const char *name, const uint32_t *hist, uint8_t buckets, uint32_t step, const char *unit) {
+    char line[160];
+    int pos = snprintf(line, sizeof(line), "%s:", name);
+    for (uint8_t i = 0; i < buckets && pos < (int)sizeof(line); i++) {
+        if (hist[i] == 0) continue;
+        pos += snprintf(line + pos, sizeof(line) - pos, " %s%u%s:%u",
+                        i == buckets - 1 ? ">=" : "<", (unsigned)((i + (i == buckets - 1 ? 0 : 1)) * step), unit, (unsigned)hist[i]);
+    }
+    STATS_PRINT("%s", line);
+}
+
+void audio_stats_print(const audio_stats_snapshot_t *s) {
+    STATS_PRINT("%s %u.%03us  packets: %u  bytes: %llu  underruns: %u  overflows: %u  dropped: %u bytes",
+                s->active ? "streaming" : "stopped", (unsigned)(s->session_ms / 1000), (unsigned)(s->session_ms % 1000),
+                (unsigned)s->packets, (unsigned long long)s->bytes, (unsigned)s->underruns, (unsigned)s->overflows,
+                (unsigned)s->dropped_bytes);
+    STATS_PRINT("ring fill min: %u  avg: %u  max: %u  i2s_write blocked: %llu ms  max: %u us  data callback max: %u us",
+                (unsigned)s->fill_min, (unsigned)s->fill_avg, (unsigned)s->fill_max,
+                (unsigned long long)(s->i2s_blocked_us / 1000), (unsigned)s->i2s_blocked_max_us,
+                (unsigned)s->cb_latency_max_us);
+    print_hist("packet bytes", s->size_hist, AUDIO_STATS_SIZE_BUCKETS, AUDIO_STATS_SIZE_STEP, "");
+    print_hist("packet interval", s->interval_hist, AUDIO_STATS_INTERVAL_BUCKETS, AUDIO_STATS_INTERVAL_STEP_US / 1000, "ms");
+}
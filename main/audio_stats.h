@@ -0,0 +1,65 @@
+#pragma once
+
+
+/*
+ * Buffer health telemetry of the audio pipeline. Counters are kept per A2DP session and
+ * reset when audio starts, ring fill levels are aggregated per report window. Updates come
+ * from the bluetooth data callback and the i2s task without locking, a snapshot taken from
+ * another task may be off by the update in flight.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+#define AUDIO_STATS_SIZE_BUCKETS        16          /*!< packet size buckets of 512 bytes */
+#define AUDIO_STATS_SIZE_STEP           512
+#define AUDIO_STATS_INTERVAL_BUCKETS    16          /*!< packet interval buckets of 4 ms */
+#define AUDIO_STATS_INTERVAL_STEP_US    4000
+
+typedef struct {
+    bool active;                    /*!< audio state is started */
+    uint32_t session_ms;            /*!< time since audio start */
+    uint32_t packets;
+    uint64_t bytes;
+    uint32_t underruns;             /*!< ring buffer ran dry while streaming */
+    uint32_t overflows;             /*!< ring buffer had no room, writer blocked */
+    uint32_t dropped_bytes;         /*!< bytes not passed on to the ring buffer */
+    uint64_t i2s_blocked_us;        /*!< total time spent in i2s_write */
+    uint32_t i2s_blocked_max_us;
+    uint32_t cb_latency_max_us;     /*!< longest bluetooth data callback */
+    uint32_t fill_min;              /*!< ring fill in bytes during the window */
+    uint32_t fill_avg;
+    uint32_t fill_max;
+    uint32_t size_hist[AUDIO_STATS_SIZE_BUCKETS];
+    uint32_t interval_hist[AUDIO_STATS_INTERVAL_BUCKETS];
+} audio_stats_snapshot_t;
+
+
+/**
+ * @brief     reset all counters and start counting underruns, call on A2DP audio start
+ */
+void audio_stats_session_start(int64_t now_us);
+void audio_stats_session_stop();
+
+void audio_stats_packet(uint32_t len, int64_t now_us);
+void audio_stats_ring_fill(uint32_t fill);
+void audio_stats_overflow();
+void audio_stats_dropped(uint32_t bytes);
+void audio_stats_underrun();
+void audio_stats_i2s_blocked(uint32_t us);
+void audio_stats_cb_latency(uint32_t us);
+
+bool audio_stats_active();
+uint32_t audio_stats_underruns();
+uint32_t audio_stats_cb_latency_max();
+
+/**
+ * @brief     copy the counters and start a new fill level window
+ */
+void audio_stats_snapshot(audio_stats_snapshot_t *snapshot, int64_t now_us);
+
+/**
+ * @brief     log a snapshot
+ */
+void audio_stats_print(const audio_stats_snapshot_t *snapshot);
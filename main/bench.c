@@ -0,0 +1,305 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "SSD1306/lcd.h"
+#include "vu_scale.h"
+#include "audio_pipeline.h"
+#include "siggen.h"
+#include "probe.h"
+#include "bench.h"
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "display.h"
+#if CONFIG_HEAP_TRACING_STANDALONE
+#include "esp_heap_trace.h"
+#endif
+
+#define BENCH_PLATFORM          "esp32"
+#else
+#define BENCH_PLATFORM          "host"
+#endif
+
+//repetitions are timed in probe ticks, a 32 bit count that wraps after 4 s on the host
+#define BENCH_MIN_REP_US        1000
+#define BENCH_MAX_OPS           (1u << 24)
+#define BENCH_MAX_REPS          64
+#define BENCH_PACKET_BYTES      4096
+#define BENCH_VU_LEVELS         64
+
+typedef struct {
+    uint8_t fb[SSD1306_BUFFERSIZE];
+    uint8_t fb_mirror[SSD1306_BUFFERSIZE];
+    uint8_t pcm[BENCH_PACKET_BYTES];
+    uint8_t da[BENCH_PACKET_BYTES * 2];
+    uint32_t vu_levels[BENCH_VU_LEVELS];
+    vu_scale_t vu_scale;
+} bench_ctx_t;
+
+typedef struct {
+    const char *name;
+    void (*run)(bench_ctx_t *ctx, uint32_t ops);
+} bench_t;
+
+static bench_ctx_t *ctx = NULL;
+static volatile uint32_t sink;
+
+
+static void bench_fb_fill(bench_ctx_t *ctx, uint32_t ops) {
+    while (ops--) fb_draw_rectangle(0, 0, SSD1306_WIDTH - 1, SSD1306_HEIGHT - 1, 1);
+}
+
+static void bench_fb_clear_rect(bench_ctx_t *ctx, uint32_t ops) {
+    while (ops--) fb_clear_rectangle(0, 0, SSD1306_WIDTH - 1, SSD1306_HEIGHT - 1);
+}
+
+//one VU meter frame: bar grows on the left channel, decays on the right
+static void bench_fb_vu_bars(bench_ctx_t *ctx, uint32_t ops) {
+    while (ops--) {
+        fb_draw_rectangle(88, 7 * 8, 127, 7 * 8 + 2, 1);
+        fb_clear_rectangle(108, 7 * 8 + 5, 127, 7 * 8 + 7);
+    }
+}
+
+static void bench_fb_draw_string(bench_ctx_t *ctx, uint32_t ops) {
+    while (ops--) fb_draw_string(0, 4, "Artist - Title 0123");
+}
+
+static void bench_fb_draw_string_big(bench_ctx_t *ctx, uint32_t ops) {
+    while (ops--) fb_draw_string_big(0, 2, "connected to");
+}
+
+static void bench_fb_draw_text(bench_ctx_t *ctx, uint32_t ops) {
+    static fb_text_t text;
+    while (ops--) fb_draw_text(&text, 0, 4, "Artist - Title 0123", false);
+}
+
+static void bench_vu_scale(bench_ctx_t *ctx, uint32_t ops) {
+    uint32_t sum = 0;
+    while (ops--) {
+        for (int i = 0; i < BENCH_VU_LEVELS; i++) sum += vu_scale_x(&ctx->vu_scale, ctx->vu_levels[i]);
+    }
+    sink = sum;
+}
+
+//peak meter ballistics and the column of reading and peak marker, one frame per level
+static void bench_vu_meter(bench_ctx_t *ctx, uint32_t ops) {
+    static const vu_ballistics_t ppm = { .integration_ms = 10, .fall_ms_per_db = 85, .peak_hold_ms = 1000 };
+    vu_meter_t meter;
+    uint32_t sum = 0;
+    vu_meter_init(&meter);
+    while (ops--) {
+        for (int i = 0; i < BENCH_VU_LEVELS; i++) {
+            vu_meter_update(&meter, &ppm, vu_scale_db(&ctx->vu_scale, ctx->vu_levels[i]), 33);
+            sum += vu_scale_db_x(&ctx->vu_scale, meter.db) + vu_scale_db_x(&ctx->vu_scale, meter.peak_db);
+        }
+    }
+    sink = sum;
+}
+
+#ifndef ESP_PLATFORM
+//the planner state is shared with the flush task on target, which sends planned windows outside fb_lock
+static void bench_lcd_diff_same(bench_ctx_t *ctx, uint32_t ops) {
+    while (ops--) lcd_update_framebuffer(ctx->fb, ctx->fb_mirror);
+}
+
+//on the target this would go to the display, the host i2c stub only counts
+static void bench_lcd_diff_vu_row(bench_ctx_t *ctx, uint32_t ops) {
+    while (ops--) {
+        ctx->fb[7 * SSD1306_WIDTH + 100 + (ops & 15)] ^= 0x07;
+        lcd_update_framebuffer(ctx->fb, ctx->fb_mirror);
+    }
+}
+
+//CPU of a complete VU meter frame: draw the bar, present and flush it
+static void bench_frame_vu(bench_ctx_t *ctx, uint32_t ops) {
+    while (ops--) {
+        uint8_t x = 100 + (ops & 15);
+        fb_draw_rectangle(88, 7 * 8, x, 7 * 8 + 2, 1);
+        fb_clear_rectangle(x + 1, 7 * 8, 127, 7 * 8 + 2);
+        fb_show();
+    }
+}
+#endif
+
+static void bench_volume_process(bench_ctx_t *ctx, uint32_t ops) {
+    uint32_t level[2];
+    while (ops--) audio_pipeline_process(ctx->pcm, BENCH_PACKET_BYTES, ctx->da, 33172, level);
+    sink = level[0];
+}
+
+//the portable reference kernel, for comparison
+static void bench_volume_bytes(bench_ctx_t *ctx, uint32_t ops) {
+    uint32_t level[2];
+    while (ops--) audio_pipeline_kernels[0].process(ctx->pcm, BENCH_PACKET_BYTES, ctx->da, 33172, level);
+    sink = level[0];
+}
+
+static const bench_t benchmarks[] = {
+    { "fb_fill",            bench_fb_fill },
+    { "fb_clear_rect",      bench_fb_clear_rect },
+    { "fb_vu_bars",         bench_fb_vu_bars },
+    { "fb_draw_string",     bench_fb_draw_string },
+    { "fb_draw_string_big", bench_fb_draw_string_big },
+    { "fb_draw_text",       bench_fb_draw_text },
+    { "vu_scale_x64",       bench_vu_scale },
+    { "vu_meter_x64",       bench_vu_meter },
+#ifndef ESP_PLATFORM
+    { "lcd_diff_same",      bench_lcd_diff_same },
+    { "lcd_diff_vu_row",    bench_lcd_diff_vu_row },
+    { "frame_vu",           bench_frame_vu },
+#endif
+    { "volume_4k_packet",   bench_volume_process },
+    { "volume_4k_bytes",    bench_volume_bytes },
+};
+
+#define BENCH_COUNT     (int)(sizeof(benchmarks) / sizeof(benchmarks[0]))
+
+
+static bool bench_ctx_init() {
+    if (ctx) return true;
+    ctx = calloc(1, sizeof(bench_ctx_t));
+    if (ctx == NULL) return false;
+
+    siggen_t gen;
+    siggen_config_t cfg;
+    siggen_default_config(&cfg);
+    cfg.type = SIGGEN_PINK;
+    siggen_init(&gen, &cfg);
+    siggen_fill(&gen, ctx->pcm, BENCH_PACKET_BYTES);
+
+    vu_scale_init(&ctx->vu_scale, 0x7fffffff, 88, 127);
+    for (int i = 0; i < BENCH_VU_LEVELS; i++) ctx->vu_levels[i] = 0x7fffffffu >> (i / 2) | i;
+    return true;
+}
+
+static void bench_ctx_free() {
+    free(ctx);
+    ctx = NULL;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+int bench_count() {
+    return BENCH_COUNT;
+}
+
+const char *bench_name(int index) {
+    return index < BENCH_COUNT ? benchmarks[index].name : NULL;
+}
+
+void bench_run(int index, uint32_t reps, bench_result_t *result) {
+    const bench_t *b = &benchmarks[index];
+    uint32_t times[BENCH_MAX_REPS];
+    uint32_t ops = 1;
+    float ticks_per_us = probe_ticks_per_us();
+    bool own_ctx = ctx == NULL;
+
+    if (!bench_ctx_init()) return;
+    if (reps == 0) reps = 1;
+    if (reps > BENCH_MAX_REPS) reps = BENCH_MAX_REPS;
+
+    //double the ops until one repetition takes long enough for the timer resolution
+    for (;;) {
+        uint32_t start = probe_now();
+        b->run(ctx, ops);
+        if (probe_now() - start >= BENCH_MIN_REP_US * ticks_per_us || ops >= BENCH_MAX_OPS) break;
+        ops *= 2;
+    }
+    for (uint32_t r = 0; r < reps; r++) {
+        uint32_t start = probe_now();
+        b->run(ctx, ops);
+        times[r] = probe_now() - start;
+    }
+    qsort(times, reps, sizeof(uint32_t), cmp_u32);
+
+    result->name = b->name;
+    result->ops = ops;
+    result->reps = reps;
+    result->ns_median = times[reps / 2] * 1000.0f / ticks_per_us / ops;
+    result->ns_min = times[0] * 1000.0f / ticks_per_us / ops;
+    if (own_ctx) bench_ctx_free();
+}
+
+#if defined(ESP_PLATFORM) && CONFIG_HEAP_TRACING_STANDALONE
+#define BENCH_HEAP_RECORDS      64
+
+//heap allocations of one display frame with a VU bar change, i2c command links included
+static void bench_heap_per_frame() {
+    static heap_trace_record_t records[BENCH_HEAP_RECORDS];
+    if (heap_trace_init_standalone(records, BENCH_HEAP_RECORDS) != ESP_OK) return;
+
+    fb_buffer()[7 * SSD1306_WIDTH + 100] ^= 0x07;
+    fb_invalidate();
+    heap_trace_start(HEAP_TRACE_ALL);
+    fb_show();
+    lcd_flush_wait();
+    heap_trace_stop();
+    printf("BENCH:# heap allocations per display frame: %u\n", heap_trace_get_count());
+}
+#endif
+
+static void bench_suite(uint32_t reps, const char *filter) {
+    bench_result_t r;
+
+#ifdef ESP_PLATFORM
+    //the benchmarks draw into the display framebuffer
+    uint8_t *saved = malloc(SSD1306_BUFFERSIZE);
+    if (saved == NULL) return;
+    display_hold(true);
+    lcd_flush_wait();
+    memcpy(saved, fb_buffer(), SSD1306_BUFFERSIZE);
+#endif
+    if (bench_ctx_init()) {
+        printf("BENCH:BEGIN %s\n", BENCH_PLATFORM);
+        for (int i = 0; i < BENCH_COUNT; i++) {
+            if (filter && !strstr(benchmarks[i].name, filter)) continue;
+            bench_run(i, reps, &r);
+            printf("BENCH:%s,%u,%u,%.1f,%.1f\n", r.name, r.ops, r.reps, r.ns_median, r.ns_min);
+        }
+#if defined(ESP_PLATFORM) && CONFIG_HEAP_TRACING_STANDALONE
+        bench_heap_per_frame();
+#endif
+        printf("BENCH:END\n");
+        bench_ctx_free();
+    }
+#ifdef ESP_PLATFORM
+    memcpy(fb_buffer(), saved, SSD1306_BUFFERSIZE);
+    fb_invalidate();
+    free(saved);
+    display_hold(false);
+#endif
+}
+
+#ifdef ESP_PLATFORM
+typedef struct {
+    uint32_t reps;
+    const char *filter;
+    TaskHandle_t caller;
+} bench_args_t;
+
+static void bench_task(void *arg) {
+    bench_args_t *args = arg;
+    bench_suite(args->reps, args->filter);
+    xTaskNotifyGive(args->caller);
+    vTaskDelete(NULL);
+}
+
+//CCOUNT is per core, the console task may migrate between repetitions
+void bench_run_all(uint32_t reps, const char *filter) {
+    bench_args_t args = { .reps = reps, .filter = filter, .caller = xTaskGetCurrentTaskHandle() };
+    if (xTaskCreatePinnedToCore(bench_task, "Bench", 4096, &args, uxTaskPriorityGet(NULL), NULL, xPortGetCoreID()) != pdPASS) return;
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+}
+#else
+void bench_run_all(uint32_t reps, const char *filter) {
+    bench_suite(reps, filter);
+}
+#endif
@@ -0,0 +1,36 @@
+#pragma once
+
+
+/*
+ * Microbenchmarks of the display and audio hot path primitives. The same suite runs on the
+ * target (console command bench) and on the host (host/bench), results are printed as
+ *   BENCH:BEGIN <platform>
+ *   BENCH:<name>,<ops per rep>,<reps>,<ns per op median>,<ns per op min>
+ *   BENCH:END
+ * for comparison against a stored baseline with host/bench -l.
+ */
+
+#include <stdint.h>
+
+typedef struct {
+    const char *name;
+    uint32_t ops;                   /*!< operations per repetition, calibrated to >= 1 ms */
+    uint32_t reps;
+    float ns_median;                /*!< per operation */
+    float ns_min;
+} bench_result_t;
+
+int bench_count();
+const char *bench_name(int index);
+
+/**
+ * @brief     run one benchmark, reps repetitions after calibration, timed with probe_now()
+ *
+ * On target the caller is pinned to one core, the cycle counter is per core.
+ */
+void bench_run(int index, uint32_t reps, bench_result_t *result);
+
+/**
+ * @brief     run all benchmarks whose name contains filter (NULL for all) and print the results
+ */
+void bench_run_all(uint32_t reps, const char *filter);
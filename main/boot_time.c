@@ -0,0 +1,42 @@
+#include <stdbool.h>
+
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include "boot_time.h"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-variable"
+static const char *TAG = "BOOT";
+#pragma GCC diagnostic pop
+
+
+static const char *boot_phase_str[BOOT_PHASE_MAX] = {
+    "app_main", "nvs", "i2c", "display task", "i2s", "bt controller",
+    "bluedroid", "display ready", "discoverable", "connected", "first audio"
+};
+
+static int64_t boot_time_us[BOOT_PHASE_MAX] = { 0 };
+
+
+void boot_time_mark(boot_phase_t phase) {
+    if (phase >= BOOT_PHASE_MAX || boot_time_us[phase] != 0) return;
+    //esp_timer starts counting shortly before app_main, keep 0 as "not reached"
+    boot_time_us[phase] = esp_timer_get_time() | 1;
+}
+
+int64_t boot_time_get(boot_phase_t phase) {
+    if (phase >= BOOT_PHASE_MAX || boot_time_us[phase] == 0) return 0;
+    return boot_time_us[phase] - boot_time_us[BOOT_PHASE_APP_MAIN];
+}
+
+void boot_time_report() {
+    int64_t last = boot_time_us[BOOT_PHASE_APP_MAIN];
+    ESP_LOGI(TAG, "boot phases (ms since reset / since app_main / step):");
+    for (uint8_t i = 0; i < BOOT_PHASE_MAX; i++) {
+        if (boot_time_us[i] == 0) continue;
+        ESP_LOGI(TAG, "  %-14s %9.3f %9.3f %9.3f", boot_phase_str[i],
+                 boot_time_us[i] / 1000.0, boot_time_get(i) / 1000.0, (boot_time_us[i] - last) / 1000.0);
+        last = boot_time_us[i];
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+
+#include <stdint.h>
+
+
+/* boot phases in the order they are expected to complete */
+typedef enum {
+    BOOT_PHASE_APP_MAIN = 0,
+    BOOT_PHASE_NVS,
+    BOOT_PHASE_I2C,
+    BOOT_PHASE_DISPLAY_TASK,
+    BOOT_PHASE_I2S,
+    BOOT_PHASE_BT_CONTROLLER,
+    BOOT_PHASE_BLUEDROID,
+    BOOT_PHASE_DISPLAY_READY,
+    BOOT_PHASE_DISCOVERABLE,
+    BOOT_PHASE_CONNECTED,
+    BOOT_PHASE_FIRST_AUDIO,
+    BOOT_PHASE_MAX
+} boot_phase_t;
+
+
+/**
+ * @brief     record the completion time of a boot phase, only the first call per phase counts
+ */
+void boot_time_mark(boot_phase_t phase);
+
+/**
+ * @brief     time in us since start of app_main when the phase completed, 0 if not reached yet
+ */
+int64_t boot_time_get(boot_phase_t phase);
+
+/**
+ * @brief     log all recorded boot phases with absolute and relative times
+ */
+void boot_time_report();
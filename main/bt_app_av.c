@@ -5,6 +5,7 @@
 #include <math.h>
 #include <sys/param.h>
 #include "esp_log.h"
+#include "esp_timer.h"
 
 #include "bt_app_core.h"
 #include "bt_app_av.h"
@@ -24,6 +25,13 @@
 #include "nvs_devices.h"
 #include "display.h"
 #include "led.h"
+#include "boot_time.h"
+#include "probe.h"
+#include "trace.h"
+#include "audio_stats.h"
+#include "rt_log.h"
+#include "audio_pipeline.h"
+#include "siggen.h"
 
 
 // AVRCP used transaction label
@@ -42,6 +50,7 @@ static void bt_av_hdl_avrc_tg_evt(uint16_t event, void *p_param);
 
 static uint32_t s_pkt_cnt = 0;
 static esp_a2d_audio_state_t s_audio_state = ESP_A2D_AUDIO_STATE_STOPPED;
+static volatile esp_a2d_connection_state_t s_a2d_conn_state = ESP_A2D_CONNECTION_STATE_DISCONNECTED;
 static const char *s_a2d_conn_state_str[] = {"Disconnected", "Connecting", "Connected", "Disconnecting"};
 static const char *s_a2d_audio_state_str[] = {"Suspended", "Stopped", "Started"};
 static esp_avrc_rn_evt_cap_mask_t s_avrc_peer_rn_cap;
@@ -74,57 +83,49 @@ void bt_app_a2d_data_cb(const uint8_t *data, uint32_t len)
 {
     static uint8_t *da_data = NULL;
     static size_t da_len = 0;
-    static const uint8_t byte_per_sample = 2;
-    static const uint8_t byte_per_da_sample = 4;
-    static int16_t sample;
-    static int32_t da_sample;
     static uint32_t level[2];
-    static uint8_t lr;
 
-    if (len % byte_per_sample != 0) ESP_LOGE(BT_AV_TAG, "data unaligned: %u", len);
+    PROBE_START(PROBE_A2D_DATA_CB);
+    TRACE(TRACE_EVT_PKT_IN, len);
+    int64_t cb_start_us = esp_timer_get_time();
+    audio_stats_packet(len, cb_start_us);
+    if (len % 2 != 0) RT_LOGE(BT_AV_TAG, "data unaligned: %u", len);
     da_len = len << 1;
 
     if (da_data == NULL) {
         da_data = (uint8_t *)malloc(RINGBUF_SIZE);
-        ESP_LOGI(BT_AV_TAG, "allocated da buffer memory: %u bytes", RINGBUF_SIZE);
-    }
-    if (RINGBUF_SIZE < da_len) {
-        ESP_LOGE(BT_AV_TAG, "audio packet size  %u  larger than buffer size  %u  bytes", da_len, RINGBUF_SIZE);
-        da_len = RINGBUF_SIZE;
-        len = RINGBUF_SIZE >> 1;
-    }
-    level[0] = 0;
-    level[1] = 0;
-    lr = 0;
-
-    for (uint32_t i = 0; i < len; i += byte_per_sample) {
-        //ESP_LOGI(BT_AV_TAG, "1: %02x%02x%02x%02x%02x%02x%02x%02x", data[i], data[i + 1], data[i + 2], data[i + 3], data[i + 4], data[i + 5], data[i + 6], data[i + 7]);
-        sample = 0;
-        for (int8_t j = byte_per_sample - 1; j >= 0; j--) {
-            sample = sample << 8;
-            sample |= data[i + j];
-        }
-
-        //apply volume
-        da_sample = (int32_t)i_volume * sample;
-        level[lr] = da_sample < 0 ? MAX(level[lr], -da_sample) : MAX(level[lr], da_sample);
-        for (uint8_t j = 0; j < byte_per_da_sample; j++) {
-            da_data[2 * i + j] = (uint8_t)(da_sample & 0xff);
-            da_sample = da_sample >> 8;
-        }
-        //ESP_LOGI(BT_AV_TAG, "2: %02x%02x%02x%02x%02x%02x%02x%02x", var_data[i], var_data[i + 1], var_data[i + 2], var_data[i + 3], var_data[i + 4], var_data[i + 5], var_data[i + 6], var_data[i + 7]);
-        lr ^= 1;
+        RT_LOGI(BT_AV_TAG, "allocated da buffer memory: %u bytes", RINGBUF_SIZE);
     }
+    if (bt_i2s_ringbuf_size() < da_len) {
+        RT_LOGE(BT_AV_TAG, "audio packet size  %u  larger than buffer size  %u  bytes", da_len, bt_i2s_ringbuf_size());
+        audio_stats_dropped(da_len - bt_i2s_ringbuf_size());
+        da_len = bt_i2s_ringbuf_size();
+        len = da_len >> 1;
+    }
+    da_len = audio_pipeline_process(data, len, da_data, i_volume, level);
     update_vu_meter(level);
 
     size_t written = write_ringbuf(da_data, da_len);
     if (written != da_len) {
-        ESP_LOGE(BT_AV_TAG, "write_ringbuf wrote  %u  of  %u  bytes", written, da_len);
+        RT_LOGE(BT_AV_TAG, "write_ringbuf wrote  %u  of  %u  bytes", written, da_len);
     }
+    if (s_pkt_cnt == 0) boot_time_mark(BOOT_PHASE_FIRST_AUDIO);
     if (++s_pkt_cnt % 100 == 0) {
-        ESP_LOGI(BT_AV_TAG, "Audio packet count %u  len %u", s_pkt_cnt, len);
+        RT_LOGI(BT_AV_TAG, "Audio packet count %u  len %u", s_pkt_cnt, len);
         display_packets(s_pkt_cnt);
     }
+    audio_stats_cb_latency(esp_timer_get_time() - cb_start_us);
+    PROBE_STOP(PROBE_A2D_DATA_CB);
+}
+
+uint32_t bt_app_get_pkt_cnt(void)
+{
+    return s_pkt_cnt;
+}
+
+bool bt_app_a2d_connected(void)
+{
+    return s_a2d_conn_state != ESP_A2D_CONNECTION_STATE_DISCONNECTED;
 }
 
 void bt_app_alloc_meta_buffer(esp_avrc_ct_cb_param_t *param)
@@ -148,6 +149,7 @@ void bt_app_rc_ct_cb(esp_avrc_ct_cb_event_t event, esp_avrc_ct_cb_param_t *param
     case ESP_AVRC_CT_CHANGE_NOTIFY_EVT:
     case ESP_AVRC_CT_REMOTE_FEATURES_EVT:
     case ESP_AVRC_CT_GET_RN_CAPABILITIES_RSP_EVT: {
+        TRACE(TRACE_EVT_AVRC_CT, event);
         bt_app_work_dispatch(bt_av_hdl_avrc_ct_evt, event, param, sizeof(esp_avrc_ct_cb_param_t), NULL);
         break;
     }
@@ -165,6 +167,7 @@ void bt_app_rc_tg_cb(esp_avrc_tg_cb_event_t event, esp_avrc_tg_cb_param_t *param
     case ESP_AVRC_TG_PASSTHROUGH_CMD_EVT:
     case ESP_AVRC_TG_SET_ABSOLUTE_VOLUME_CMD_EVT:
     case ESP_AVRC_TG_REGISTER_NOTIFICATION_EVT:
+        TRACE(TRACE_EVT_AVRC_TG, event);
         bt_app_work_dispatch(bt_av_hdl_avrc_tg_evt, event, param, sizeof(esp_avrc_tg_cb_param_t), NULL);
         break;
     default:
@@ -188,8 +191,12 @@ static void bt_av_hdl_a2d_evt(uint16_t event, void *p_param)
     case ESP_A2D_CONNECTION_STATE_EVT: {
         a2d = (esp_a2d_cb_param_t *)(p_param);
         uint8_t *bda = a2d->conn_stat.remote_bda;
+        TRACE(TRACE_EVT_A2D, event << 8 | a2d->conn_stat.state);
         ESP_LOGI(BT_AV_TAG, "A2DP connection state: %s, [%02x:%02x:%02x:%02x:%02x:%02x]",
              s_a2d_conn_state_str[a2d->conn_stat.state], bda[0], bda[1], bda[2], bda[3], bda[4], bda[5]);
+        //a phone replaces the test signal source, from connecting until it is gone no source starts
+        s_a2d_conn_state = a2d->conn_stat.state;
+        siggen_source_stop();
         if (a2d->conn_stat.state == ESP_A2D_CONNECTION_STATE_DISCONNECTED) {
             esp_bt_gap_set_scan_mode(ESP_BT_CONNECTABLE, ESP_BT_GENERAL_DISCOVERABLE);
             display_state("disconnected", NULL, 3);
@@ -206,6 +213,7 @@ static void bt_av_hdl_a2d_evt(uint16_t event, void *p_param)
             get_remote_name(bda, &remote_name);
             display_state("connected to", remote_name, 3);
             led_on(ORANGE);
+            boot_time_mark(BOOT_PHASE_CONNECTED);
 
             bt_i2s_task_start_up();
         }
@@ -213,15 +221,26 @@ static void bt_av_hdl_a2d_evt(uint16_t event, void *p_param)
     }
     case ESP_A2D_AUDIO_STATE_EVT: {
         a2d = (esp_a2d_cb_param_t *)(p_param);
+        TRACE(TRACE_EVT_A2D, event << 8 | a2d->audio_stat.state);
         ESP_LOGI(BT_AV_TAG, "A2DP audio state: %s", s_a2d_audio_state_str[a2d->audio_stat.state]);
         s_audio_state = a2d->audio_stat.state;
         if (ESP_A2D_AUDIO_STATE_STARTED == a2d->audio_stat.state) {
             s_pkt_cnt = 0;
+            audio_stats_session_start(esp_timer_get_time());
+            display_streaming(true);
+        }
+        else {
+            audio_stats_session_stop();
+            display_streaming(false);
+#if CONFIG_TRACE_DUMP_ON_STOP
+            trace_request_dump();
+#endif
         }
         break;
     }
     case ESP_A2D_AUDIO_CFG_EVT: {
         a2d = (esp_a2d_cb_param_t *)(p_param);
+        TRACE(TRACE_EVT_A2D, event << 8);
         ESP_LOGI(BT_AV_TAG, "A2DP audio stream configuration, codec type %d", a2d->audio_cfg.mcc.type);
         // for now only SBC stream is supported
         if (a2d->audio_cfg.mcc.type == ESP_A2D_MCT_SBC) {
@@ -235,7 +254,7 @@ static void bt_av_hdl_a2d_evt(uint16_t event, void *p_param)
                 sample_rate = 48000;
             }
 
-            i2s_set_clk(0, sample_rate, 32, 2);
+            bt_i2s_set_sample_rate(sample_rate);
 
             ESP_LOGI(BT_AV_TAG, "Configure audio player %x-%x-%x-%x",
                      a2d->audio_cfg.mcc.cie.sbc[0],
@@ -353,25 +372,17 @@ static void bt_av_hdl_avrc_ct_evt(uint16_t event, void *p_param)
 }
 
 
-static uint8_t vol_to_pct(uint8_t vol) {
-    return (uint32_t)vol * 100 / 0x7f;
-};
-
-
-#define VOL_MIN         30.0
-#define VOL_MAX         65536.0
+//set from the stored tuning by tuning_init before bluetooth starts
+static audio_volume_curve_t s_volume_curve;
 
-#define VOL_POWER       3.0
-static const float vol_pow_min = pow(VOL_MIN, (1.0 / VOL_POWER));
-static const float vol_pow_diff = pow(VOL_MAX, (1.0 / VOL_POWER)) - pow(VOL_MIN, (1.0 / VOL_POWER));
 
-//calculate volume with power function
-static uint32_t vol_calc_pow(uint8_t vol) {
-    if (vol == 0) return 0;
-    if (vol == 0x7f) return VOL_MAX;
-
-    //ESP_LOGI(BT_RC_TG_TAG, "vol_pow_min: %f  vol_pow_diff: %f  vol_to_pct: %u  VOL_POWER: %f", vol_pow_min, vol_pow_diff, vol_to_pct(vol), VOL_POWER);
-    return floor(pow((vol_pow_min + vol_pow_diff / 100 * vol_to_pct(vol)), VOL_POWER));
+void volume_curve_set(uint16_t vol_min, float power)
+{
+    _lock_acquire(&s_volume_lock);
+    audio_pipeline_volume_curve(&s_volume_curve, vol_min, power);
+    i_volume = audio_pipeline_volume_factor(&s_volume_curve, s_volume);
+    _lock_release(&s_volume_lock);
+    ESP_LOGI(BT_RC_TG_TAG, "Volume curve min %u power %.1f, volume %d (%u)", vol_min, power, s_volume, i_volume);
 }
 
 
@@ -379,9 +390,9 @@ static void volume_set_by_controller(uint8_t volume)
 {
     _lock_acquire(&s_volume_lock);
     s_volume = volume;
-    i_volume = vol_calc_pow(volume);
+    i_volume = audio_pipeline_volume_factor(&s_volume_curve, volume);
     _lock_release(&s_volume_lock);
-    ESP_LOGI(BT_RC_TG_TAG, "Volume is set by remote controller %d (%u) -> %d%%", volume, i_volume, vol_to_pct((int32_t)volume));
+    ESP_LOGI(BT_RC_TG_TAG, "Volume is set by remote controller %d (%u) -> %d%%", volume, i_volume, audio_pipeline_volume_pct((int32_t)volume));
 
     display_volume(s_volume);
 }
@@ -390,9 +401,9 @@ void volume_set_by_local_host(uint8_t volume)
 {
     _lock_acquire(&s_volume_lock);
     s_volume = volume;
-    i_volume = vol_calc_pow(volume);
+    i_volume = audio_pipeline_volume_factor(&s_volume_curve, volume);
     _lock_release(&s_volume_lock);
-    ESP_LOGI(BT_RC_TG_TAG, "Volume is set locally to: %d (%u) -> %d%%", volume, i_volume, vol_to_pct((int32_t)volume));
+    ESP_LOGI(BT_RC_TG_TAG, "Volume is set locally to: %d (%u) -> %d%%", volume, i_volume, audio_pipeline_volume_pct((int32_t)volume));
 
     if (s_volume_notify && ! s_volume_notify_disabled) {
         esp_avrc_rn_param_t rn_param;
@@ -422,11 +433,11 @@ void volume_max() {
 
 void volume_up(uint8_t vol_diff) {
     if (s_volume == 0x7f) return;
-    uint8_t new_pct = MIN(100, vol_to_pct(s_volume) + vol_diff);
+    uint8_t new_pct = MIN(100, audio_pipeline_volume_pct(s_volume) + vol_diff);
     uint8_t new_vol = s_volume;
-    while (vol_to_pct(new_vol) != new_pct) new_vol++;
+    while (audio_pipeline_volume_pct(new_vol) != new_pct) new_vol++;
     volume_set_by_local_host(new_vol);
-    //ESP_LOGI(BT_RC_TG_TAG, "modify volume: old: %02x  %d%%  change: %d%%  new: %02x", s_volume, vol_to_pct(s_volume), change, pct_to_vol((int32_t)vol_to_pct(s_volume) + (int32_t)change));
+    //ESP_LOGI(BT_RC_TG_TAG, "modify volume: old: %02x  %d%%  change: %d%%  new: %02x", s_volume, audio_pipeline_volume_pct(s_volume), change, pct_to_vol((int32_t)audio_pipeline_volume_pct(s_volume) + (int32_t)change));
 }
 void volume_down(uint8_t vol_diff) {
     if (s_volume == 0) return;
@@ -434,7 +445,7 @@ void volume_down(uint8_t vol_diff) {
         volume_set_by_local_host(0);
         return;
     }
-    uint8_t new_pct = vol_to_pct(s_volume);
+    uint8_t new_pct = audio_pipeline_volume_pct(s_volume);
     if (new_pct <= vol_diff) {
         new_pct = 0;
     }
@@ -442,7 +453,7 @@ void volume_down(uint8_t vol_diff) {
         new_pct -= vol_diff;
     }
     uint8_t new_vol = s_volume;
-    while (vol_to_pct(new_vol) != new_pct) new_vol--;
+    while (audio_pipeline_volume_pct(new_vol) != new_pct) new_vol--;
     volume_set_by_local_host(new_vol);
 }
 
@@ -462,7 +473,7 @@ static void bt_av_hdl_avrc_tg_evt(uint16_t event, void *p_param)
         break;
     }
     case ESP_AVRC_TG_SET_ABSOLUTE_VOLUME_CMD_EVT: {
-        ESP_LOGI(BT_RC_TG_TAG, "AVRC set absolute volume: %d%%", vol_to_pct((int32_t)rc->set_abs_vol.volume * 100 / 0x7f));
+        ESP_LOGI(BT_RC_TG_TAG, "AVRC set absolute volume: %d%%", audio_pipeline_volume_pct((int32_t)rc->set_abs_vol.volume * 100 / 0x7f));
         volume_set_by_controller(rc->set_abs_vol.volume);
         break;
     }
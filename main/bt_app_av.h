@@ -2,6 +2,7 @@
 
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "esp_a2dp_api.h"
 #include "esp_avrc_api.h"
 
@@ -20,6 +21,16 @@ void bt_app_a2d_cb(esp_a2d_cb_event_t event, esp_a2d_cb_param_t *param);
  */
 void bt_app_a2d_data_cb(const uint8_t *data, uint32_t len);
 
+/**
+ * @brief     audio packets received since the last A2DP audio start
+ */
+uint32_t bt_app_get_pkt_cnt(void);
+
+/**
+ * @brief     an A2DP connection exists or is being set up or torn down
+ */
+bool bt_app_a2d_connected(void);
+
 /**
  * @brief     callback function for AVRCP controller
  */
@@ -30,6 +41,11 @@ void bt_app_rc_ct_cb(esp_avrc_ct_cb_event_t event, esp_avrc_ct_cb_param_t *param
  */
 void bt_app_rc_tg_cb(esp_avrc_tg_cb_event_t event, esp_avrc_tg_cb_param_t *param);
 
+/**
+ * @brief     volume factor curve: vol_min at 1% up to 65536 at 100% with the given exponent
+ */
+void volume_curve_set(uint16_t vol_min, float power);
+
 void volume_set_by_local_host(uint8_t volume);
 void volume_mute();
 void volume_restore();
@@ -14,10 +14,16 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
 #include "bt_app_core.h"
 #include "driver/i2s.h"
 #include "freertos/ringbuf.h"
+#include "esp_timer.h"
+#include "audio_stats.h"
+#include "tuning.h"
+#include "probe.h"
+#include "trace.h"
 
 static void bt_app_task_handler(void *arg);
 static bool bt_app_send_msg(bt_app_msg_t *msg);
@@ -27,6 +33,15 @@ static xQueueHandle s_bt_app_task_queue = NULL;
 static xTaskHandle s_bt_app_task_handle = NULL;
 static xTaskHandle s_bt_i2s_task_handle = NULL;
 static RingbufHandle_t s_ringbuf_i2s = NULL;;
+static bt_i2s_counters_t s_i2s_counters = { 0 };
+static latency_config_t s_i2s_installed = { 0 };
+static uint32_t s_ringbuf_size = RINGBUF_SIZE;
+static uint32_t s_underrun_ms = 30;
+static int s_sample_rate = 48000;
+static volatile int64_t s_i2s_write_start_us = 0;
+//start up, shut down and restart of ring buffer and i2s task come from the BT app, console and watchdog tasks
+static StaticSemaphore_t s_i2s_lock_buf;
+static SemaphoreHandle_t s_i2s_lock = NULL;
 
 bool bt_app_work_dispatch(bt_app_cb_t p_cback, uint16_t event, void *p_params, int param_len, bt_app_copy_cb_t p_copy_cback)
 {
@@ -99,6 +114,9 @@ static void bt_app_task_handler(void *arg)
 
 void bt_app_task_start_up(void)
 {
+    if (s_i2s_lock == NULL) {
+        s_i2s_lock = xSemaphoreCreateMutexStatic(&s_i2s_lock_buf);
+    }
     s_bt_app_task_queue = xQueueCreate(10, sizeof(bt_app_msg_t));
     xTaskCreate(bt_app_task_handler, "BtAppT", 3072, NULL, configMAX_PRIORITIES - 3, &s_bt_app_task_handle);
     return;
@@ -118,32 +136,172 @@ void bt_app_task_shut_down(void)
 
 static void bt_i2s_task_handler(void *arg)
 {
+    //its own handle, a restart clears the global for the writers while this task may still run
+    RingbufHandle_t ringbuf = (RingbufHandle_t)arg;
     uint8_t *data = NULL;
     size_t item_size = 0;
     size_t bytes_written = 0;
+    bool dry = false;
+    int64_t write_start_us;
 
     for (;;) {
-        data = (uint8_t *)xRingbufferReceive(s_ringbuf_i2s, &item_size, (portTickType)portMAX_DELAY);
+        //ring buffer empty for longer than the DMA buffers last counts as underrun
+        data = (uint8_t *)xRingbufferReceive(ringbuf, &item_size, pdMS_TO_TICKS(s_underrun_ms));
+        if (data == NULL) {
+            //count each dry period once
+            if (!dry) audio_stats_underrun();
+            dry = true;
+            continue;
+        }
+        dry = false;
         if (item_size != 0){
+            uint32_t fill = s_ringbuf_size - xRingbufferGetCurFreeSize(ringbuf);
+            TRACE(TRACE_EVT_RING_READ, fill);
+            audio_stats_ring_fill(fill);
+            PROBE_START(PROBE_I2S_WRITE);
+            write_start_us = esp_timer_get_time();
+            s_i2s_write_start_us = write_start_us;
             i2s_write(0, data, item_size, &bytes_written, portMAX_DELAY);
-            vRingbufferReturnItem(s_ringbuf_i2s,(void *)data);
+            s_i2s_write_start_us = 0;
+            audio_stats_i2s_blocked(esp_timer_get_time() - write_start_us);
+            PROBE_STOP(PROBE_I2S_WRITE);
+            TRACE(TRACE_EVT_I2S_DONE, bytes_written);
+            vRingbufferReturnItem(ringbuf,(void *)data);
+            s_i2s_counters.bytes_out += bytes_written;
         }
     }
 }
 
-void bt_i2s_task_start_up(void)
+void bt_i2s_driver_install(int sample_rate)
+{
+    const latency_config_t *latency = tuning_latency_config(tuning_get()->latency);
+    i2s_config_t i2s_config = {
+#ifdef CONFIG_A2DP_SINK_OUTPUT_INTERNAL_DAC
+        .mode = I2S_MODE_MASTER | I2S_MODE_TX | I2S_MODE_DAC_BUILT_IN,
+#else
+        .mode = I2S_MODE_MASTER | I2S_MODE_TX,                                  // Only TX
+#endif
+        .sample_rate = sample_rate,
+        .bits_per_sample = 32,
+        .channel_format = I2S_CHANNEL_FMT_RIGHT_LEFT,                           //2-channels
+        .communication_format = I2S_COMM_FORMAT_STAND_I2S,
+        .dma_buf_count = latency->dma_buf_count,
+        .dma_buf_len = latency->dma_buf_len,
+        .intr_alloc_flags = 0,                                                  //Default interrupt priority
+        .tx_desc_auto_clear = true,                                              //Auto clear tx descriptor on underflow
+        .use_apll = true
+    };
+
+    i2s_driver_install(0, &i2s_config, 0, NULL);
+
+#ifdef CONFIG_A2DP_SINK_OUTPUT_INTERNAL_DAC
+    i2s_set_dac_mode(I2S_DAC_CHANNEL_BOTH_EN);
+    i2s_set_pin(0, NULL);
+#else
+    i2s_pin_config_t pin_config = {
+        .bck_io_num = CONFIG_I2S_BCK_PIN,
+        .ws_io_num = CONFIG_I2S_LRCK_PIN,
+        .data_out_num = CONFIG_I2S_DATA_PIN,
+        .data_in_num = -1                                                       //Not used
+    };
+
+    i2s_set_pin(0, &pin_config);
+#endif
+
+    s_i2s_installed = *latency;
+    s_sample_rate = sample_rate;
+    s_underrun_ms = latency->dma_buf_count * latency->dma_buf_len * 1000 / sample_rate;
+}
+
+esp_err_t bt_i2s_set_sample_rate(int sample_rate)
+{
+    s_sample_rate = sample_rate;
+    s_underrun_ms = s_i2s_installed.dma_buf_count * s_i2s_installed.dma_buf_len * 1000 / sample_rate;
+    return i2s_set_clk(0, sample_rate, 32, 2);
+}
+
+uint32_t bt_i2s_ringbuf_size(void)
+{
+    return s_ringbuf_size;
+}
+
+static void bt_i2s_task_create(void)
 {
-    s_ringbuf_i2s = xRingbufferCreate(RINGBUF_SIZE, RINGBUF_TYPE_BYTEBUF);
+    const latency_config_t *latency = tuning_latency_config(tuning_get()->latency);
+    if (latency->dma_buf_count != s_i2s_installed.dma_buf_count || latency->dma_buf_len != s_i2s_installed.dma_buf_len) {
+        ESP_LOGI(BT_APP_CORE_TAG, "%s reinstall i2s driver: dma %u x %u", __func__, latency->dma_buf_count, latency->dma_buf_len);
+        i2s_driver_uninstall(0);
+        bt_i2s_driver_install(s_sample_rate);
+    }
+    s_ringbuf_size = latency->ringbuf_size;
+
+    s_ringbuf_i2s = xRingbufferCreate(s_ringbuf_size, RINGBUF_TYPE_BYTEBUF);
     if(s_ringbuf_i2s == NULL){
         return;
     }
 
-    xTaskCreate(bt_i2s_task_handler, "BtI2ST", 1024, NULL, configMAX_PRIORITIES - 3, &s_bt_i2s_task_handle);
+    //pinned, the i2s_write probe spans a blocking call and the cycle counters of the cores are unrelated
+    xTaskCreatePinnedToCore(bt_i2s_task_handler, "BtI2ST", 2048, s_ringbuf_i2s, configMAX_PRIORITIES - 3, &s_bt_i2s_task_handle, 1);
     return;
 }
 
+void bt_i2s_task_start_up(void)
+{
+    xSemaphoreTake(s_i2s_lock, portMAX_DELAY);
+    bt_i2s_task_create();
+    xSemaphoreGive(s_i2s_lock);
+}
+
+void bt_i2s_flush(void)
+{
+    i2s_zero_dma_buffer(0);
+    i2s_stop(0);
+    i2s_start(0);
+}
+
+void bt_i2s_task_restart(void)
+{
+    xSemaphoreTake(s_i2s_lock, portMAX_DELAY);
+    //shut down in the meantime, nothing to restart
+    if (s_bt_i2s_task_handle == NULL) {
+        xSemaphoreGive(s_i2s_lock);
+        return;
+    }
+    RingbufHandle_t ringbuf = s_ringbuf_i2s;
+
+    //writers see no ring buffer from now on, one blocked in write_ringbuf times out first.
+    //the i2s task keeps its own handle until it is deleted
+    s_ringbuf_i2s = NULL;
+    if (s_bt_i2s_task_handle) {
+        vTaskDelete(s_bt_i2s_task_handle);
+        s_bt_i2s_task_handle = NULL;
+    }
+    vTaskDelay(2 * RINGBUF_WRITE_TIMEOUT_MS / portTICK_PERIOD_MS);
+    if (ringbuf) {
+        vRingbufferDelete(ringbuf);
+    }
+    s_i2s_write_start_us = 0;
+
+    //a task deleted inside i2s_write leaves the driver locked, start from scratch
+    i2s_driver_uninstall(0);
+    bt_i2s_driver_install(s_sample_rate);
+    bt_i2s_task_create();
+    xSemaphoreGive(s_i2s_lock);
+}
+
+bool bt_i2s_task_running(void)
+{
+    return s_bt_i2s_task_handle != NULL;
+}
+
+int64_t bt_i2s_write_started_us(void)
+{
+    return s_i2s_write_start_us;
+}
+
 void bt_i2s_task_shut_down(void)
 {
+    xSemaphoreTake(s_i2s_lock, portMAX_DELAY);
     if (s_bt_i2s_task_handle) {
         vTaskDelete(s_bt_i2s_task_handle);
         s_bt_i2s_task_handle = NULL;
@@ -153,14 +311,46 @@ void bt_i2s_task_shut_down(void)
         vRingbufferDelete(s_ringbuf_i2s);
         s_ringbuf_i2s = NULL;
     }
+    xSemaphoreGive(s_i2s_lock);
+}
+
+uint32_t bt_i2s_ringbuf_fill(void)
+{
+    uint32_t fill = 0;
+
+    xSemaphoreTake(s_i2s_lock, portMAX_DELAY);
+    if (s_ringbuf_i2s) {
+        fill = s_ringbuf_size - xRingbufferGetCurFreeSize(s_ringbuf_i2s);
+    }
+    xSemaphoreGive(s_i2s_lock);
+    return fill;
 }
 
 size_t write_ringbuf(const uint8_t *data, size_t size)
 {
-    BaseType_t done = xRingbufferSend(s_ringbuf_i2s, (void *)data, size, (portTickType)portMAX_DELAY);
+    RingbufHandle_t ringbuf = s_ringbuf_i2s;
+    if (ringbuf == NULL) {
+        audio_stats_dropped(size);
+        return 0;
+    }
+    PROBE_START(PROBE_WRITE_RINGBUF);
+    if (xRingbufferGetCurFreeSize(ringbuf) < size) audio_stats_overflow();
+    BaseType_t done = xRingbufferSend(ringbuf, (void *)data, size, pdMS_TO_TICKS(RINGBUF_WRITE_TIMEOUT_MS));
+    PROBE_STOP(PROBE_WRITE_RINGBUF);
     if (done) {
+        uint32_t fill = s_ringbuf_size - xRingbufferGetCurFreeSize(ringbuf);
+        TRACE(TRACE_EVT_RING_WRITE, fill);
+        audio_stats_ring_fill(fill);
+        s_i2s_counters.bytes_in += size;
         return size;
     } else {
+        s_i2s_counters.short_writes++;
+        audio_stats_dropped(size);
         return 0;
     }
-}
\ No newline at end of file
+}
+
+void bt_i2s_get_counters(bt_i2s_counters_t *counters)
+{
+    *counters = s_i2s_counters;
+}
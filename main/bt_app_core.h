@@ -4,12 +4,26 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include "esp_err.h"
 
 #define BT_APP_CORE_TAG                   "BT_APP_CORE"
 
 #define BT_APP_SIG_WORK_DISPATCH          (0x01)
 
 #define RINGBUF_SIZE                      40 * 1024
+/* the bluetooth data callback gives up on a full ring buffer after this time */
+#define RINGBUF_WRITE_TIMEOUT_MS          100
+
+/* DMA geometry of the normal latency profile */
+#define I2S_DMA_BUF_COUNT                 12
+#define I2S_DMA_BUF_LEN                   120
+
+/* counters of the ring buffer between bluetooth data callback and i2s task */
+typedef struct {
+    uint64_t bytes_in;          /*!< bytes written to the ring buffer */
+    uint64_t bytes_out;         /*!< bytes passed on to i2s_write */
+    uint32_t short_writes;      /*!< ring buffer writes that failed */
+} bt_i2s_counters_t;
 
 /**
  * @brief     handler for the dispatched work
@@ -38,8 +52,50 @@ void bt_app_task_start_up(void);
 
 void bt_app_task_shut_down(void);
 
+/**
+ * @brief     install the i2s driver with the DMA geometry of the current latency profile
+ */
+void bt_i2s_driver_install(int sample_rate);
+
+esp_err_t bt_i2s_set_sample_rate(int sample_rate);
+
+/**
+ * @brief     size of the ring buffer of the current connection
+ */
+uint32_t bt_i2s_ringbuf_size(void);
+
+/**
+ * @brief     bytes in the ring buffer now, including the item the i2s task is writing, 0 without ring buffer
+ */
+uint32_t bt_i2s_ringbuf_fill(void);
+
+/**
+ * @brief     create ring buffer and i2s task, a changed latency profile is applied here
+ */
 void bt_i2s_task_start_up(void);
 
 void bt_i2s_task_shut_down(void);
 
+/**
+ * @brief     pipeline watchdog recovery: clear DMA buffers and restart the i2s peripheral
+ */
+void bt_i2s_flush(void);
+
+/**
+ * @brief     pipeline watchdog recovery: recreate ring buffer, i2s task and i2s driver, unless shut down
+ */
+void bt_i2s_task_restart(void);
+
+/**
+ * @brief     ring buffer and i2s task exist
+ */
+bool bt_i2s_task_running(void);
+
+/**
+ * @brief     esp_timer time when the running i2s_write started, 0 if none is running
+ */
+int64_t bt_i2s_write_started_us(void);
+
 size_t write_ringbuf(const uint8_t *data, size_t size);
+
+void bt_i2s_get_counters(bt_i2s_counters_t *counters);
@@ -0,0 +1,208 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_console.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#include "sys_metrics.h"
+#include "task_stats.h"
+#include "probe.h"
+#include "trace.h"
+#include "boot_time.h"
+#include "tuning.h"
+#include "persist_stats.h"
+#include "siggen.h"
+#include "bench.h"
+#include "cmd_console.h"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-variable"
+static const char *TAG = "CONSOLE";
+#pragma GCC diagnostic pop
+
+
+static int report_err(esp_err_t err) {
+    if (err != ESP_OK) {
+        printf("failed: %s\n", esp_err_to_name(err));
+        return 1;
+    }
+    tuning_print();
+    return 0;
+}
+
+//whole argument as a number within min..max, checked before it is narrowed to the setting's type
+static bool parse_long(const char *arg, long min, long max, long *value) {
+    char *end;
+    *value = strtol(arg, &end, 10);
+    return end != arg && *end == 0 && *value >= min && *value <= max;
+}
+
+static bool parse_float(const char *arg, float min, float max, float *value) {
+    char *end;
+    *value = strtof(arg, &end);
+    return end != arg && *end == 0 && *value >= min && *value <= max;
+}
+
+static int cmd_stats(int argc, char **argv) {
+    sys_metrics_report();
+    return 0;
+}
+
+static int cmd_tasks(int argc, char **argv) {
+    //the sample of the metrics task, sampling here would cut its window short
+    sys_metrics_lock();
+    task_stats_print();
+    sys_metrics_unlock();
+    return 0;
+}
+
+static int cmd_probes(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        probe_reset();
+        return 0;
+    }
+    sys_metrics_lock();
+    probe_dump();
+    sys_metrics_unlock();
+    return 0;
+}
+
+static int cmd_trace(int argc, char **argv) {
+    trace_dump();
+    return 0;
+}
+
+static int cmd_boot(int argc, char **argv) {
+    boot_time_report();
+    return 0;
+}
+
+static int cmd_persist(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "clear") == 0) persist_stats_clear();
+    persist_stats_print();
+    return 0;
+}
+
+static int cmd_latency(int argc, char **argv) {
+    if (argc < 2) return report_err(ESP_OK);
+    for (uint8_t p = 0; p < LATENCY_MAX; p++) {
+        if (strcmp(argv[1], tuning_latency_name(p)) == 0) {
+            printf("applied with the next connection\n");
+            return report_err(tuning_set_latency(p));
+        }
+    }
+    printf("unknown profile: %s\n", argv[1]);
+    return 1;
+}
+
+static int cmd_volcurve(int argc, char **argv) {
+    long vol_min;
+    float power;
+    if (argc < 3) return report_err(ESP_OK);
+    if (!parse_long(argv[1], 0, UINT16_MAX, &vol_min) || !parse_float(argv[2], 0, 25.5, &power)) return report_err(ESP_ERR_INVALID_ARG);
+    return report_err(tuning_set_volume_curve(vol_min, (uint8_t)(power * 10 + 0.5)));
+}
+
+static int cmd_meter(int argc, char **argv) {
+    long decay_ms;
+    if (argc < 2) return report_err(ESP_OK);
+    if (!parse_long(argv[1], 0, UINT16_MAX, &decay_ms)) return report_err(ESP_ERR_INVALID_ARG);
+    return report_err(tuning_set_vu_decay(decay_ms));
+}
+
+static int cmd_refresh(int argc, char **argv) {
+    long refresh_ms;
+    if (argc < 2) return report_err(ESP_OK);
+    if (!parse_long(argv[1], 0, UINT16_MAX, &refresh_ms)) return report_err(ESP_ERR_INVALID_ARG);
+    return report_err(tuning_set_display_refresh(refresh_ms));
+}
+
+static int cmd_siggen(int argc, char **argv) {
+    siggen_config_t cfg;
+    uint32_t packet_bytes = 4096;
+
+    if (argc < 2) {
+        printf("%s\n", siggen_source_running() ? "running" : "stopped");
+        return 0;
+    }
+    if (strcmp(argv[1], "stop") == 0) {
+        siggen_source_stop();
+        return 0;
+    }
+    siggen_default_config(&cfg);
+    cfg.type = siggen_type(argv[1]);
+    if (cfg.type == SIGGEN_MAX) {
+        printf("unknown signal: %s\n", argv[1]);
+        return 1;
+    }
+    if (cfg.type == SIGGEN_SWEEP) cfg.freq = 20;
+    if (cfg.type == SIGGEN_IMPULSE) cfg.freq = 2;
+    long rate = cfg.sample_rate, bytes = packet_bytes;
+    if ((argc > 2 && !parse_float(argv[2], 0, SIGGEN_RATE_MAX, &cfg.freq)) ||
+        (argc > 3 && !parse_float(argv[3], SIGGEN_LEVEL_MIN, 0, &cfg.level_db)) ||
+        (argc > 4 && !parse_long(argv[4], SIGGEN_RATE_MIN, SIGGEN_RATE_MAX, &rate)) ||
+        (argc > 5 && !parse_long(argv[5], SIGGEN_PACKET_MIN, SIGGEN_PACKET_MAX, &bytes))) {
+        printf("failed: %s\n", esp_err_to_name(ESP_ERR_INVALID_ARG));
+        return 1;
+    }
+    cfg.sample_rate = rate;
+    packet_bytes = bytes;
+    //the sweep ends at 20 kHz, or a little below half of a low rate
+    if (cfg.type == SIGGEN_SWEEP && cfg.freq_end >= cfg.sample_rate / 2.0f) cfg.freq_end = cfg.sample_rate * 0.45f;
+
+    esp_err_t err = siggen_source_start(&cfg, packet_bytes);
+    if (err != ESP_OK) {
+        printf("failed: %s\n", esp_err_to_name(err));
+        return 1;
+    }
+    return 0;
+}
+
+static int cmd_bench(int argc, char **argv) {
+    bench_run_all(15, argc > 1 ? argv[1] : NULL);
+    return 0;
+}
+
+static int cmd_tuning(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) return report_err(tuning_reset());
+    return report_err(ESP_OK);
+}
+
+static const esp_console_cmd_t commands[] = {
+    { .command = "stats",    .help = "heap, ring buffer and underrun counters, task load, probes", .func = &cmd_stats },
+    { .command = "tasks",    .help = "cpu load and stack high water mark per task of the last periodic sample", .func = &cmd_tasks },
+    { .command = "probes",   .help = "hot path latency histograms", .hint = "[reset]", .func = &cmd_probes },
+    { .command = "trace",    .help = "dump the pipeline event trace", .func = &cmd_trace },
+    { .command = "boot",     .help = "boot phase timing", .func = &cmd_boot },
+    { .command = "persist",  .help = "counters kept across resets: reset reasons, underruns, max latency, min heap", .hint = "[clear]", .func = &cmd_persist },
+    { .command = "latency",  .help = "ring buffer and DMA profile", .hint = "[low|normal|safe]", .func = &cmd_latency },
+    { .command = "volcurve", .help = "volume curve, factor at 1% and exponent", .hint = "[<min> <power>]", .func = &cmd_volcurve },
+    { .command = "meter",    .help = "peak meter fall time in ms per dB", .hint = "[<ms>]", .func = &cmd_meter },
+    { .command = "refresh",  .help = "VU meter frame period while streaming", .hint = "[<ms>]", .func = &cmd_refresh },
+    { .command = "siggen",   .help = "test signal source instead of a phone, impulse freq is per second", .hint = "[silence|sine|sweep|pink|impulse|stop] [<freq> [<dBFS> [<rate> [<packet bytes>]]]]", .func = &cmd_siggen },
+    { .command = "bench",    .help = "display and audio microbenchmarks, the display pauses meanwhile", .hint = "[<filter>]", .func = &cmd_bench },
+    { .command = "tuning",   .help = "show tuning parameters or restore the defaults", .hint = "[reset]", .func = &cmd_tuning },
+};
+
+
+void cmd_console_start() {
+    esp_console_repl_t *repl = NULL;
+    esp_console_repl_config_t repl_config = ESP_CONSOLE_REPL_CONFIG_DEFAULT();
+    esp_console_dev_uart_config_t uart_config = ESP_CONSOLE_DEV_UART_CONFIG_DEFAULT();
+    repl_config.prompt = "bt>";
+
+    esp_err_t err = esp_console_new_repl_uart(&uart_config, &repl_config, &repl);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "%s failed: %s", __func__, esp_err_to_name(err));
+        return;
+    }
+    esp_console_register_help_command();
+    for (uint8_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+        esp_console_cmd_register(&commands[i]);
+    }
+    esp_console_start_repl(repl);
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+
+/**
+ * @brief     start the interactive UART console with stats and tuning commands
+ */
+void cmd_console_start();
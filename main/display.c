@@ -1,13 +1,18 @@
-#include <math.h>
 #include <sys/param.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
 
 #include "display.h"
+#include "boot_time.h"
+#include "probe.h"
 #include "SSD1306/lcd.h"
+#include "vu_scale.h"
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-variable"
@@ -16,170 +21,351 @@ static const char *TAG = "DISPLAY";
 
 
 
+//updates posted to the renderer, the newest of each kind wins
+typedef enum {
+    DISPLAY_MSG_STATE = 0,
+    DISPLAY_MSG_VOLUME,
+    DISPLAY_MSG_SAMPLE_RATE,
+    DISPLAY_MSG_PACKETS,
+    DISPLAY_MSG_REBOOT,
+    DISPLAY_MSG_STREAMING,
+    DISPLAY_MSG_MAX
+} display_msg_type_t;
+
+typedef struct {
+    uint8_t type;
+    union {
+        uint32_t value;
+        struct {
+            char text[DISPLAY_STATE_LEN];
+            char remote_name[DISPLAY_NAME_LEN];
+            bool has_remote_name;
+            uint8_t offset;
+        } state;
+    };
+} display_msg_t;
+
+#define DISPLAY_QUEUE_LEN       16
+//longest wait for room in the queue and for the reboot screen to be shown
+#define DISPLAY_REBOOT_WAIT_MS  500
+
 static char lcd_string_buffer[64];
+//texts that come back unchanged, the packet counter changes with every update
+static fb_text_t state_text, remote_name_text, volume_text, sample_rate_text;
 static bool freezed = false;
+static volatile bool reboot_shown = false;
+static volatile bool held = false;
+//display_hold waits until the task has seen the hold with the latest number
+static uint32_t hold_seq = 0;
+static uint32_t hold_ack = 0;
+static xQueueHandle display_queue = NULL;
+static TaskHandle_t display_task_handle = NULL;
+static uint32_t dropped = 0;
+static bool streaming = false;
+static display_stats_t stats;
 extern const uint8_t *dev_name;
 extern const uint8_t *last_device;
 extern const int32_t default_sample_rate;
 
-//ms per pixel decay rate
-static uint32_t vu_decay = 51;
+//peak programme meter by default, the fall rate comes from the tuning
+static vu_ballistics_t vu_ballistics = {
+    .integration_ms = CONFIG_DISPLAY_VU_INTEGRATION_MS,
+#if CONFIG_DISPLAY_VU_BALLISTICS_VU
+    .fall_ms_per_db = 0,
+#else
+    .fall_ms_per_db = 85,
+#endif
+    .peak_hold_ms = CONFIG_DISPLAY_VU_PEAK_HOLD_MS,
+};
+//VU meter frame period while streaming, other updates are drawn when they come in
+static uint32_t refresh_ms = 1000 / CONFIG_DISPLAY_VU_FPS;
 static uint8_t vu_x_start = 48 + 40;
 static uint8_t vu_x_end = 127;
-static uint8_t vu_x_end_l = 48 + 40;
-static uint8_t vu_x_end_r = 48 + 40;
-static uint8_t vu_x_size = 127 - (48 + 40);
-static float vu_x_10db_scale = (128.0 - (48.0 + 40.0)) / 7.0;
-static float vu_x_db_scale = 0;
-static float vu_db_min = 0;
-static uint32_t vu_max = 0;
-static uint32_t vu_min = 0;
-static uint32_t vu_last_update_l_ms = 0;
-static uint32_t vu_last_update_r_ms = 0;
+static vu_scale_t vu_scale;
+static vu_meter_t vu_meter[2];
+//highest levels since the last frame
 static uint32_t vu_level[2] = { 0, 0 };
 
 static void render_vu_meter();
+static bool vu_bars_at_rest();
+static void render_msg(const display_msg_t *msg);
 
+//the only task drawing after display_init, producers post messages and wake it
 void display_task() {
+    static display_msg_t pending[DISPLAY_MSG_MAX];
+    static bool have[DISPLAY_MSG_MAX];
+    display_msg_t msg;
+    int64_t vu_next_us = 0;
+    bool vu_running = false;
+
     ESP_LOGI(TAG, "display task core: %u", xPortGetCoreID());
+    //controller setup and first framebuffer push take ~100ms at 100kHz, run it here in parallel to bluetooth bring-up
+    lcd_init();
+    boot_time_mark(BOOT_PHASE_DISPLAY_READY);
+    //updates posted during the controller setup
+    xTaskNotifyGive(xTaskGetCurrentTaskHandle());
     for (;;) {
-        if (!freezed) {
+        //the VU meter runs at the frame rate while streaming and until its bars are back at rest, otherwise idle
+        TickType_t wait = portMAX_DELAY;
+        if (vu_running) {
+            int64_t wait_us = vu_next_us - esp_timer_get_time();
+            wait = wait_us > 0 ? (wait_us / 1000 + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS : 0;
+        }
+        ulTaskNotifyTake(pdTRUE, wait);
+        int64_t start_us = esp_timer_get_time();
+        stats.wakeups++;
+
+        //collect what came in since the last frame, held updates wait until release
+        bool changed = false;
+        while (xQueueReceive(display_queue, &msg, 0) == pdTRUE) {
+            pending[msg.type] = msg;
+            have[msg.type] = true;
+        }
+        if (freezed || held) {
+            if (held) __atomic_store_n(&hold_ack, __atomic_load_n(&hold_seq, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+            vu_running = false;
+            continue;
+        }
+        bool vu_due = vu_running && start_us >= vu_next_us;
+
+        PROBE_START(PROBE_RENDER_VU);
+        fb_lock();
+        for (int type = 0; type < DISPLAY_MSG_MAX; type++) {
+            if (have[type]) {
+                render_msg(&pending[type]);
+                changed = true;
+            }
+            have[type] = false;
+        }
+        if (vu_due) {
             render_vu_meter();
+            //a late frame does not make the next ones come faster
+            vu_next_us = MAX(vu_next_us + refresh_ms * 1000, start_us);
+        }
+        fb_unlock();
+        PROBE_STOP(PROBE_RENDER_VU);
+        if (changed || vu_due) {
+            //hands the frame to the flush task, the bus transfer runs in the background
+            PROBE_START(PROBE_FB_SHOW);
             fb_show();
+            PROBE_STOP(PROBE_FB_SHOW);
+            stats.frames++;
+            if (freezed) reboot_shown = true;
         }
-        vTaskDelay(10 / portTICK_RATE_MS);
+
+        bool vu_was_running = vu_running;
+        vu_running = !freezed && (streaming || !vu_bars_at_rest());
+        if (vu_running && !vu_was_running) vu_next_us = start_us;
+        stats.busy_us += esp_timer_get_time() - start_us;
     }
 }
 
 
+static bool display_send(const display_msg_t *msg, TickType_t wait) {
+    //a waiting sender makes sure the renderer is awake to make room
+    if (wait && display_task_handle) xTaskNotifyGive(display_task_handle);
+    if (display_queue == NULL || xQueueSend(display_queue, msg, wait) != pdTRUE) {
+        //posted from the BT, console and button tasks
+        __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+    if (display_task_handle) xTaskNotifyGive(display_task_handle);
+    return true;
+}
+
+static void display_post(const display_msg_t *msg) {
+    //never blocks, a full queue only happens while the renderer is held or stuck
+    display_send(msg, 0);
+}
+
+
 static void init_vu_meter(uint32_t max) {
-    vu_max = max;
-
-    //80db -> factor 10000
-    vu_min = max / 10000;
-    vu_db_min = log10(vu_min);
-    vu_x_db_scale = vu_x_size / (log10(max) - vu_db_min);
-
-    float db_px = 127;
-    while (db_px >= vu_x_start + 1) {
-        fb_draw_pixel((uint8_t)round(db_px), 7 * 8 + 3, 1);
-        fb_draw_pixel((uint8_t)round(db_px), 7 * 8 + 4, 1);
-        db_px -= vu_x_10db_scale;
+    vu_scale_init(&vu_scale, max, vu_x_start, vu_x_end);
+    vu_meter_init(&vu_meter[0]);
+    vu_meter_init(&vu_meter[1]);
+
+    //a mark every 10 dB
+    for (int db = 0; db > -VU_DB_RANGE; db -= 10) {
+        fb_draw_v_line(vu_scale_db_x(&vu_scale, db * 256), 7 * 8 + 3, 2);
     }
 }
 
+//packet peak levels, the renderer takes the highest since its last frame
+//the data callback raises the mailbox to the highest level since the last frame, the renderer empties it
+static void vu_level_max(uint32_t *slot, uint32_t level) {
+    uint32_t old = __atomic_load_n(slot, __ATOMIC_RELAXED);
+    while (level > old && !__atomic_compare_exchange_n(slot, &old, level, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
 void update_vu_meter(uint32_t level[2]) {
-    vu_level[0] = level[0];
-    vu_level[1] = level[1];
+    vu_level_max(&vu_level[0], level[0]);
+    vu_level_max(&vu_level[1], level[1]);
 }
 
-static uint8_t vu_x_end_l_new = 0;
-static uint8_t vu_x_end_r_new = 0;
+static void render_vu_bar(vu_meter_t *meter, uint32_t level, uint32_t elapsed_ms, uint8_t y) {
+    vu_meter_update(meter, &vu_ballistics, vu_scale_db(&vu_scale, level), elapsed_ms);
+    uint8_t x = vu_scale_db_x(&vu_scale, meter->db);
+
+    fb_draw_rectangle(vu_x_start, y, x, y + 2, 1);
+    fb_clear_rectangle(x + 1, y, 127, y + 2);
+    if (vu_ballistics.peak_hold_ms && meter->peak_db > meter->db) {
+        fb_draw_v_line(vu_scale_db_x(&vu_scale, meter->peak_db), y, 3);
+    }
+}
 
 static void render_vu_meter() {
+    static int64_t last_us = 0;
     if (freezed) return;
-    static uint32_t now_ms;
-    now_ms = esp_timer_get_time() / 1000;
+    int64_t now_us = esp_timer_get_time();
+    uint32_t elapsed_ms = last_us ? (now_us - last_us) / 1000 : 0;
+    //the remainder counts for the next frame
+    last_us = last_us ? last_us + elapsed_ms * 1000 : now_us;
 
-    vu_x_end_l_new = MAX(MIN(round(vu_level[0] <= vu_min ? vu_x_start : (log10(vu_level[0]) - vu_db_min) * vu_x_db_scale + vu_x_start), vu_x_end), vu_x_start);
-    vu_x_end_r_new = MAX(MIN(round(vu_level[1] <= vu_min ? vu_x_start : (log10(vu_level[1]) - vu_db_min) * vu_x_db_scale + vu_x_start), vu_x_end), vu_x_start);
-    //ESP_LOGI(TAG, "%s:  vu_x_size: %u  vu_x_db_scale: %f  vu_db_min: %f  vu_level[0]: %u  vu_level[1]: %u  vu_x_end_l_new: %u  vu_x_end_r_new: %u", __func__, vu_x_size, vu_x_db_scale, vu_db_min, vu_level[0], vu_level[1], vu_x_end_l_new, vu_x_end_r_new);
+    uint32_t level[2] = { __atomic_exchange_n(&vu_level[0], 0, __ATOMIC_RELAXED), __atomic_exchange_n(&vu_level[1], 0, __ATOMIC_RELAXED) };
+    render_vu_bar(&vu_meter[0], level[0], elapsed_ms, 7 * 8);
+    render_vu_bar(&vu_meter[1], level[1], elapsed_ms, 7 * 8 + 5);
+}
 
-    if (vu_x_end_l_new >= vu_x_end_l) {
-        vu_x_end_l = vu_x_end_l_new;
-        fb_draw_rectangle(vu_x_start, 7 * 8, vu_x_end_l, 7 * 8 + 2, 1);
-        vu_last_update_l_ms = now_ms;
-    }
-    else {
-        while (now_ms - vu_last_update_l_ms >= vu_decay && vu_x_end_l > vu_x_start && vu_x_end_l >= vu_x_end_l_new) {
-            vu_last_update_l_ms += vu_decay;
-            vu_x_end_l--;
-        }
-        fb_clear_rectangle(vu_x_end_l + 1, 7 * 8, 127, 7 * 8 + 2);
-    }
-    if (vu_x_end_r_new >= vu_x_end_r) {
-        vu_x_end_r = vu_x_end_r_new;
-        fb_draw_rectangle(vu_x_start, 7 * 8 + 5, vu_x_end_r, 7 * 8 + 7, 1);
-        vu_last_update_r_ms = now_ms;
-    }
-    else {
-        while (now_ms - vu_last_update_r_ms >= vu_decay && vu_x_end_r > vu_x_start && vu_x_end_r >= vu_x_end_r_new) {
-            vu_last_update_r_ms += vu_decay;
-            vu_x_end_r--;
-        }
-        fb_clear_rectangle(vu_x_end_r + 1, 7 * 8 + 5, 127, 7 * 8 + 7);
-    }
+//both readings and peak markers down and no level that raises them
+static bool vu_bars_at_rest() {
+    return vu_meter_at_rest(&vu_meter[0]) && vu_meter_at_rest(&vu_meter[1]) &&
+           __atomic_load_n(&vu_level[0], __ATOMIC_RELAXED) <= vu_scale.min && __atomic_load_n(&vu_level[1], __ATOMIC_RELAXED) <= vu_scale.min;
 }
 
 
 void display_init() {
-    lcd_init();
+    lcd_set_bus(CONFIG_I2C_MASTER_FREQUENCY, CONFIG_DISPLAY_BUS_BUDGET_US);
+    lcd_set_priority_region(vu_x_start, vu_x_end, 7, 7);
+    fb_init();
+    display_queue = xQueueCreate(DISPLAY_QUEUE_LEN, sizeof(display_msg_t));
+
+    //drawn here before the renderer starts
     fb_clear();
     snprintf(lcd_string_buffer, sizeof(lcd_string_buffer), "     %s", dev_name);
     fb_draw_string_big (0, 0, lcd_string_buffer);
-    display_sample_rate(default_sample_rate);
+    render_msg(&(display_msg_t){ .type = DISPLAY_MSG_SAMPLE_RATE, .value = default_sample_rate });
     init_vu_meter(0x7fffffff);
-    update_vu_meter((uint32_t[2]){ 0, 0 });
+    render_vu_meter();
 
-    xTaskCreate(
+    xTaskCreatePinnedToCore(
         display_task,           /* Task function. */
         "DisplayRefresh",       /* String with name of task. */
         10000,                  /* Stack size in bytes. */
         NULL,                   /* Parameter passed as input of the task */
         0,                      /* Priority of the task. */
-        NULL
-    );                          /* Task handle. */
+        &display_task_handle,   /* Task handle. */
+        1                       /* Core, bluetooth controller and bluedroid run on core 0 */
+    );
+    boot_time_mark(BOOT_PHASE_DISPLAY_TASK);
+}
+
+static void render_msg(const display_msg_t *msg) {
+    switch (msg->type) {
+    case DISPLAY_MSG_STATE:
+        fb_clear_line(2);
+        fb_clear_line(3);
+        fb_draw_text(&state_text, msg->state.offset, 2, msg->state.text, true);
+        fb_clear_line(4);
+        if (msg->state.has_remote_name) fb_draw_text(&remote_name_text, 0, 4, msg->state.remote_name, false);
+        break;
+    case DISPLAY_MSG_VOLUME:
+        snprintf(lcd_string_buffer, sizeof(lcd_string_buffer), "%*u%%", 3, msg->value * 100 / 0x7f);
+        fb_draw_text(&volume_text, 86, 5, lcd_string_buffer, true);
+        fb_draw_rectangle(0, 5 * 8, msg->value * 83 / 0x7f, 7 * 8 - 3, 1);
+        fb_clear_rectangle(msg->value * 83 / 0x7f + 1, 5 * 8, 83, 7 * 8 - 3);
+        break;
+    case DISPLAY_MSG_SAMPLE_RATE:
+        snprintf(lcd_string_buffer, sizeof(lcd_string_buffer), " sr: %u", msg->value);
+        fb_clear_line_part(7, 0, 44);
+        fb_draw_text(&sample_rate_text, 0, 7, lcd_string_buffer, false);
+        break;
+    case DISPLAY_MSG_PACKETS:
+        snprintf(lcd_string_buffer, sizeof(lcd_string_buffer), "%*u", 8, msg->value);
+        fb_clear_line_part(7, 45, 87);
+        fb_draw_string(45, 7, lcd_string_buffer);
+        break;
+    case DISPLAY_MSG_REBOOT:
+        freezed = true;
+        fb_clear();
+        snprintf(lcd_string_buffer, sizeof(lcd_string_buffer), "     %s", dev_name);
+        fb_draw_string_big (0, 0, lcd_string_buffer);
+        fb_draw_string_big (0, 2, "release");
+        fb_draw_string_big (0, 4, "buttons");
+        fb_draw_string_big (0, 6, "to reboot...");
+        break;
+    case DISPLAY_MSG_STREAMING:
+        //without levels coming in the bars fall back with the ballistics
+        streaming = msg->value;
+        break;
+    }
 }
 
 void display_volume(uint8_t vol) {
-    if (freezed) return;
-    snprintf(lcd_string_buffer, sizeof(lcd_string_buffer), "%*d%%", 3, (uint32_t)vol * 100 / 0x7f);
-    fb_draw_string_big(86, 5, lcd_string_buffer);
-    fb_draw_rectangle(0, 5 * 8, vol * 83 / 0x7f, 7 * 8 - 3, 1);
-    fb_clear_rectangle(vol * 83 / 0x7f + 1, 5 * 8, 83, 7 * 8 - 3);
+    display_post(&(display_msg_t){ .type = DISPLAY_MSG_VOLUME, .value = vol });
 }
 
 void display_state(char *state, uint8_t *remote_name, uint8_t offset) {
-    if (freezed) return;
-    snprintf(lcd_string_buffer, sizeof(lcd_string_buffer), state);
-    fb_clear_line(2);
-    fb_clear_line(3);
-    fb_draw_string_big (offset, 2, lcd_string_buffer);
-
-    fb_clear_line(4);
-    if (remote_name) {
-        snprintf(lcd_string_buffer, sizeof(lcd_string_buffer), "%s", remote_name);
-        fb_draw_string(0, 4, lcd_string_buffer);
-    }
+    display_msg_t msg = { .type = DISPLAY_MSG_STATE };
+    snprintf(msg.state.text, sizeof(msg.state.text), "%s", state);
+    if (remote_name) snprintf(msg.state.remote_name, sizeof(msg.state.remote_name), "%s", remote_name);
+    msg.state.has_remote_name = remote_name != NULL;
+    msg.state.offset = offset;
+    display_post(&msg);
 }
 
 void display_sample_rate(int sample_rate) {
-    if (freezed) return;
-    snprintf(lcd_string_buffer, sizeof(lcd_string_buffer), " sr: %d", default_sample_rate);
-    fb_clear_line_part(7, 0, 44);
-    fb_draw_string(0, 7, lcd_string_buffer);
+    display_post(&(display_msg_t){ .type = DISPLAY_MSG_SAMPLE_RATE, .value = sample_rate });
 }
 
 void display_packets(uint32_t packets) {
-    if (freezed) return;
-    snprintf(lcd_string_buffer, sizeof(lcd_string_buffer), "%*u", 8, packets);
-    fb_clear_line_part(7, 45, 87);
-    fb_draw_string(45, 7, lcd_string_buffer);
+    display_post(&(display_msg_t){ .type = DISPLAY_MSG_PACKETS, .value = packets });
 }
 
+void display_streaming(bool started) {
+    display_post(&(display_msg_t){ .type = DISPLAY_MSG_STREAMING, .value = started });
+}
 
-void display_reboot() {
-    freezed = true;
-    vTaskDelay(20 / portTICK_RATE_MS);
-    fb_clear();
-    snprintf(lcd_string_buffer, sizeof(lcd_string_buffer), "     %s", dev_name);
-    fb_draw_string_big (0, 0, lcd_string_buffer);
+void display_get_stats(display_stats_t *s) {
+    *s = stats;
+    s->streaming = streaming;
+}
+
+uint32_t display_dropped() {
+    return __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+}
 
-    snprintf(lcd_string_buffer, sizeof(lcd_string_buffer), "release");
-    fb_draw_string_big (0, 2, lcd_string_buffer);
-    snprintf(lcd_string_buffer, sizeof(lcd_string_buffer), "buttons");
-    fb_draw_string_big (0, 4, lcd_string_buffer);
-    snprintf(lcd_string_buffer, sizeof(lcd_string_buffer), "to reboot...");
-    fb_draw_string_big (0, 6, lcd_string_buffer);
-    fb_show();
+
+void display_set_vu_decay(uint16_t decay_ms) {
+#if !CONFIG_DISPLAY_VU_BALLISTICS_VU
+    vu_ballistics.fall_ms_per_db = decay_ms;
+#endif
+}
+
+void display_set_refresh(uint16_t ms) {
+    refresh_ms = ms;
+}
+
+
+void display_hold(bool hold) {
+    if (!hold) {
+        held = false;
+        //draw what came in meanwhile
+        if (display_task_handle) xTaskNotifyGive(display_task_handle);
+        return;
+    }
+    //the number goes up before held is set, a task that sees the hold acknowledges this one
+    uint32_t seq = __atomic_add_fetch(&hold_seq, 1, __ATOMIC_SEQ_CST);
+    held = true;
+    if (display_task_handle == NULL) return;
+    //a running frame finishes first, then the task acknowledges and stops drawing
+    xTaskNotifyGive(display_task_handle);
+    while (__atomic_load_n(&hold_ack, __ATOMIC_SEQ_CST) != seq) vTaskDelay(1);
+}
+
+
+void display_reboot() {
+    //the screen asks to release the buttons, which reboots, so it must neither get lost nor come too late
+    if (!display_send(&(display_msg_t){ .type = DISPLAY_MSG_REBOOT }, DISPLAY_REBOOT_WAIT_MS / portTICK_PERIOD_MS)) return;
+    for (int i = 0; !reboot_shown && i < DISPLAY_REBOOT_WAIT_MS / portTICK_PERIOD_MS; i++) vTaskDelay(1);
+    lcd_flush_wait();
 }
@@ -1,10 +1,53 @@
 #pragma once
 
 
+#include <stdint.h>
+#include <stdbool.h>
+
+/* text of a state update, longer strings are cut */
+#define DISPLAY_STATE_LEN       16
+#define DISPLAY_NAME_LEN        32
+
+/*
+ * The display_* updates post a message to the DisplayRefresh task, which owns the
+ * framebuffer. They never draw or block and are safe from any task.
+ */
+
 void display_init();
 void display_volume(uint8_t vol);
 void display_state(char *state, uint8_t *remote_name, uint8_t offset);
 void display_sample_rate(int sample_rate);
 void display_packets(uint32_t packets);
+void display_streaming(bool started);
 void update_vu_meter(uint32_t level[2]);
+//shows the reboot screen and returns once it is on the display
 void display_reboot();
+//fall time of the peak meter ballistics, VU ballistics fall with their integration time
+void display_set_vu_decay(uint16_t decay_ms);
+//VU meter frame period while streaming
+void display_set_refresh(uint16_t refresh_ms);
+
+/*
+ * The display task sleeps until an update comes in. While audio streams and until the VU
+ * bars have fallen back it also wakes at the VU meter frame rate.
+ */
+typedef struct {
+    uint32_t wakeups;
+    uint32_t frames;                //handed to the flush task
+    uint64_t busy_us;               //rendering, waiting not included
+    bool streaming;
+} display_stats_t;
+
+void display_get_stats(display_stats_t *s);
+
+/**
+ * @brief     updates lost because the message queue was full
+ */
+uint32_t display_dropped();
+
+/**
+ * @brief     stop rendering and flushing the framebuffer, e.g. while benchmarks draw into it
+ *
+ * A hold returns once the display task has finished its frame and stopped drawing.
+ */
+void display_hold(bool hold);
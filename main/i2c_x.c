@@ -1,9 +1,23 @@
 #include <stdio.h>
 #include "esp_log.h"
 #include "driver/i2c.h"
-#include "sdkconfig.h"
 #include "i2c_x.h"
 
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "sdkconfig.h"
+
+static StaticSemaphore_t link_mutex_buf;
+static SemaphoreHandle_t link_mutex = NULL;
+
+#define I2C_LINK_LOCK()     xSemaphoreTake(link_mutex, portMAX_DELAY)
+#define I2C_LINK_UNLOCK()   xSemaphoreGive(link_mutex)
+#else
+#define I2C_LINK_LOCK()
+#define I2C_LINK_UNLOCK()
+#endif
+
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-variable"
@@ -11,7 +25,11 @@ static const char *TAG = "I2C master";
 #pragma GCC diagnostic pop
 
 
+//command link storage for one transaction, no heap use per transaction
+static uint8_t link_buf[I2C_LINK_RECOMMENDED_SIZE(I2C_MAX_SEGMENTS)];
+
 
+#ifdef ESP_PLATFORM
 esp_err_t i2c_init(void)
 {
     int i2c_master_port = I2C_MASTER_NUM;
@@ -24,6 +42,7 @@ esp_err_t i2c_init(void)
     conf.master.clk_speed = I2C_MASTER_FREQ_HZ;
     conf.clk_flags = 0;
     i2c_param_config(i2c_master_port, &conf);
+    link_mutex = xSemaphoreCreateMutexStatic(&link_mutex_buf);
     esp_err_t ret = i2c_driver_install(i2c_master_port, conf.mode,
                               I2C_MASTER_RX_BUF_DISABLE,
                               I2C_MASTER_TX_BUF_DISABLE, 0);
@@ -34,6 +53,12 @@ esp_err_t i2c_init(void)
 
     return ret;
 }
+#else
+esp_err_t i2c_init(void)
+{
+    return ESP_OK;
+}
+#endif
 
 
 esp_err_t i2c_master_read_slave(uint8_t i2c_slave_addr, uint8_t *data_rd, size_t size, uint16_t wait_ms)
@@ -41,7 +66,8 @@ esp_err_t i2c_master_read_slave(uint8_t i2c_slave_addr, uint8_t *data_rd, size_t
     if (size == 0) {
         return ESP_OK;
     }
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    I2C_LINK_LOCK();
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create_static(link_buf, sizeof(link_buf));
     i2c_master_start(cmd);
     i2c_master_write_byte(cmd, i2c_slave_addr | READ_BIT, ACK_CHECK_EN);
     if (size > 1) {
@@ -50,7 +76,8 @@ esp_err_t i2c_master_read_slave(uint8_t i2c_slave_addr, uint8_t *data_rd, size_t
     i2c_master_read_byte(cmd, data_rd + size - 1, NACK_VAL);
     i2c_master_stop(cmd);
     esp_err_t ret = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, wait_ms / portTICK_RATE_MS);
-    i2c_cmd_link_delete(cmd);
+    i2c_cmd_link_delete_static(cmd);
+    I2C_LINK_UNLOCK();
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "%s failed: %s", __func__, esp_err_to_name(ret));
     }
@@ -66,13 +93,41 @@ esp_err_t i2c_master_read_slave(uint8_t i2c_slave_addr, uint8_t *data_rd, size_t
  */
 esp_err_t i2c_master_write_slave(uint8_t i2c_slave_addr, uint8_t *data_wr, size_t size, uint16_t wait_ms)
 {
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, i2c_slave_addr | WRITE_BIT, ACK_CHECK_EN);
-    i2c_master_write(cmd, data_wr, size, ACK_CHECK_EN);
-    i2c_master_stop(cmd);
-    esp_err_t ret = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, wait_ms / portTICK_RATE_MS);
-    i2c_cmd_link_delete(cmd);
+    i2c_segment_t segment = { .data = data_wr, .size = size, .start = true };
+    return i2c_master_write_segments(i2c_slave_addr, &segment, 1, wait_ms);
+}
+
+/**
+ * __________________________________________________________________________________________
+ * | start | slave_addr + wr_bit + ack | segment ... | repeated start | slave_addr ... | stop |
+ * --------|---------------------------|-------------|----------------|----------------|------|
+ *
+ * The segment data is not copied and must stay unchanged until the call returns.
+ */
+esp_err_t i2c_master_write_segments(uint8_t i2c_slave_addr, const i2c_segment_t *segments, size_t count, uint16_t wait_ms)
+{
+    esp_err_t ret = ESP_OK;
+    if (count == 0 || count > I2C_MAX_SEGMENTS || !segments[0].start) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    I2C_LINK_LOCK();
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create_static(link_buf, sizeof(link_buf));
+    for (size_t i = 0; i < count && ret == ESP_OK; i++) {
+        if (segments[i].start) {
+            i2c_master_start(cmd);
+            ret = i2c_master_write_byte(cmd, i2c_slave_addr | WRITE_BIT, ACK_CHECK_EN);
+        }
+        if (ret == ESP_OK && segments[i].size) {
+            ret = i2c_master_write(cmd, segments[i].data, segments[i].size, ACK_CHECK_EN);
+        }
+    }
+    if (ret == ESP_OK) {
+        i2c_master_stop(cmd);
+        ret = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, wait_ms / portTICK_RATE_MS);
+    }
+    i2c_cmd_link_delete_static(cmd);
+    I2C_LINK_UNLOCK();
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "%s failed: %s", __func__, esp_err_to_name(ret));
     }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stdbool.h>
 
 #include "esp_err.h"
 #include "esp_log.h"
@@ -26,8 +27,25 @@
 #define I2C_WAIT_MS_DEFAULT 1000
 #define I2C_WAIT_MS_LONG    5000
 
+//segments of one write transaction, fits a display window of 8 pages
+#define I2C_MAX_SEGMENTS    12
+
+/**
+ * @brief     part of a write transaction, start begins it with a (repeated) start condition and the address byte
+ */
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    bool start;
+} i2c_segment_t;
+
 
 
 esp_err_t i2c_init(void);
 esp_err_t i2c_master_read_slave(uint8_t i2c_slave_addr, uint8_t *data_rd, size_t size, uint16_t wait_ms);
 esp_err_t i2c_master_write_slave(uint8_t i2c_slave_addr, uint8_t *data_wr, size_t size, uint16_t wait_ms);
+
+/**
+ * @brief     write the segments in one transaction from a static command link, the first segment must have start set
+ */
+esp_err_t i2c_master_write_segments(uint8_t i2c_slave_addr, const i2c_segment_t *segments, size_t count, uint16_t wait_ms);
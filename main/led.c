@@ -3,6 +3,9 @@
 #include "led.h"
 
 
+static uint8_t led_color = 0;
+
+
 void led_init() {
     gpio_config_t io_conf;
     //disable interrupt
@@ -21,12 +24,14 @@ void led_init() {
 
 
 void led_off() {
+    led_color = 0;
     gpio_set_level(GPIO_OUTPUT_IO_RED, 0);
     gpio_set_level(GPIO_OUTPUT_IO_GREEN, 0);
 }
 
 
 void led_on(uint8_t color) {
+    led_color = color;
     switch (color) {
     case RED:
         gpio_set_level(GPIO_OUTPUT_IO_RED, 1);
@@ -45,3 +50,8 @@ void led_on(uint8_t color) {
         gpio_set_level(GPIO_OUTPUT_IO_GREEN, 0);
     }
 }
+
+
+uint8_t led_get() {
+    return led_color;
+}
@@ -16,3 +16,4 @@
 void led_init();
 void led_off();
 void led_on(uint8_t color);
+uint8_t led_get();
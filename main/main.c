@@ -43,8 +43,19 @@
 #include "button.h"
 #include "led.h"
 #include "timer_delay.h"
-
+#include "boot_time.h"
+#include "sys_metrics.h"
+#include "rt_log.h"
+#include "tuning.h"
+#include "cmd_console.h"
+#include "persist_stats.h"
+#include "pipeline_wdt.h"
+#include "siggen.h"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-variable"
 static const char *TAG = "BT-PCM5102 main";
+#pragma GCC diagnostic pop
 
 
 /* event for handler "bt_av_hdl_stack_up */
@@ -140,20 +151,12 @@ static void process_button_task()
 }
 
 
-void output_running_info() {
-    uint8_t loop_count = 0;
-    while (1) {
-        if (loop_count++ == 1) {
-            loop_count = 0;
-            ESP_LOGI(TAG, "task loop is running. free heap: %d", heap_caps_get_free_size(MALLOC_CAP_8BIT));
-        }
-        delay_us(10000000);
-        esp_task_wdt_reset();
-    }
-}
-
 void app_main(void)
 {
+    boot_time_mark(BOOT_PHASE_APP_MAIN);
+    persist_stats_init();
+    rt_log_start();
+
     /* Initialize NVS — it is used to store PHY calibration data */
     esp_err_t err = nvs_flash_init();
     if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
@@ -161,43 +164,17 @@ void app_main(void)
         err = nvs_flash_init();
     }
     ESP_ERROR_CHECK(err);
+    boot_time_mark(BOOT_PHASE_NVS);
+    tuning_init();
+    siggen_source_init();
 
     i2c_init();
+    boot_time_mark(BOOT_PHASE_I2C);
+    /* only draws the framebuffer, the display itself is initialized by the refresh task in parallel */
     display_init();
 
-    i2s_config_t i2s_config = {
-#ifdef CONFIG_A2DP_SINK_OUTPUT_INTERNAL_DAC
-        .mode = I2S_MODE_MASTER | I2S_MODE_TX | I2S_MODE_DAC_BUILT_IN,
-#else
-        .mode = I2S_MODE_MASTER | I2S_MODE_TX,                                  // Only TX
-#endif
-        .sample_rate = default_sample_rate,
-        .bits_per_sample = 32,
-        .channel_format = I2S_CHANNEL_FMT_RIGHT_LEFT,                           //2-channels
-        .communication_format = I2S_COMM_FORMAT_STAND_I2S,
-        .dma_buf_count = 12,
-        .dma_buf_len = 120,
-        .intr_alloc_flags = 0,                                                  //Default interrupt priority
-        .tx_desc_auto_clear = true,                                              //Auto clear tx descriptor on underflow
-        .use_apll = true
-    };
-
-
-    i2s_driver_install(0, &i2s_config, 0, NULL);
-
-#ifdef CONFIG_A2DP_SINK_OUTPUT_INTERNAL_DAC
-    i2s_set_dac_mode(I2S_DAC_CHANNEL_BOTH_EN);
-    i2s_set_pin(0, NULL);
-#else
-    i2s_pin_config_t pin_config = {
-        .bck_io_num = CONFIG_I2S_BCK_PIN,
-        .ws_io_num = CONFIG_I2S_LRCK_PIN,
-        .data_out_num = CONFIG_I2S_DATA_PIN,
-        .data_in_num = -1                                                       //Not used
-    };
-
-    i2s_set_pin(0, &pin_config);
-#endif
+    bt_i2s_driver_install(default_sample_rate);
+    boot_time_mark(BOOT_PHASE_I2S);
 
     led_init();
     led_off();
@@ -214,6 +191,7 @@ void app_main(void)
         ESP_LOGE(BT_AV_TAG, "%s enable controller failed: %s", __func__, esp_err_to_name(err));
         return;
     }
+    boot_time_mark(BOOT_PHASE_BT_CONTROLLER);
 
     if ((err = esp_bluedroid_init()) != ESP_OK) {
         ESP_LOGE(BT_AV_TAG, "%s initialize bluedroid failed: %s", __func__, esp_err_to_name(err));
@@ -224,6 +202,7 @@ void app_main(void)
         ESP_LOGE(BT_AV_TAG, "%s enable bluedroid failed: %s", __func__, esp_err_to_name(err));
         return;
     }
+    boot_time_mark(BOOT_PHASE_BLUEDROID);
 
     /* create application task */
     bt_app_task_start_up();
@@ -259,14 +238,13 @@ void app_main(void)
         NULL
     );                          /* Task handle. */
 
-    xTaskCreate(
-        output_running_info,    /* Task function. */
-        "LoopRunning",          /* String with name of task. */
-        2048,                   /* Stack size in bytes. */
-        NULL,                   /* Parameter passed as input of the task */
-        0,                      /* Priority of the task. */
-        NULL
-    );                          /* Task handle. */
+    sys_metrics_start();
+#if CONFIG_PIPELINE_WDT_ENABLE
+    pipeline_wdt_start();
+#endif
+#if CONFIG_CONSOLE_ENABLE
+    cmd_console_start();
+#endif
 
     ESP_LOGI(BT_AV_TAG, "tasks created: app_main finished: core: %u", xPortGetCoreID());
 }
@@ -347,6 +325,8 @@ static void bt_av_hdl_stack_evt(uint16_t event, void *p_param)
 
         /* set discoverable and connectable mode, wait to be connected */
         esp_bt_gap_set_scan_mode(ESP_BT_CONNECTABLE, ESP_BT_GENERAL_DISCOVERABLE);
+        boot_time_mark(BOOT_PHASE_DISCOVERABLE);
+        boot_time_report();
 
         volume_set_by_local_host(volume_default);
 
@@ -0,0 +1,106 @@
+#include <string.h>
+#include <stddef.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_system.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+
+#include "persist_stats.h"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-variable"
+static const char *TAG = "PERSIST";
+#pragma GCC diagnostic pop
+
+#define PERSIST_MAGIC           0x50435354
+
+
+static const char *reset_reason_str[] = {
+    "unknown", "power on", "external", "software", "panic", "interrupt wdt", "task wdt", "other wdt",
+    "deep sleep", "brownout", "sdio"
+};
+
+static RTC_NOINIT_ATTR persist_stats_t persist;
+static portMUX_TYPE persist_lock = portMUX_INITIALIZER_UNLOCKED;
+
+
+static uint32_t persist_crc() {
+    return esp_rom_crc32_le(0, (const uint8_t *)&persist, offsetof(persist_stats_t, crc));
+}
+
+static const char *reason_str(uint32_t reason) {
+    return reason < sizeof(reset_reason_str) / sizeof(reset_reason_str[0]) ? reset_reason_str[reason] : "?";
+}
+
+void persist_stats_init() {
+    esp_reset_reason_t reason = esp_reset_reason();
+
+    if (persist.magic != PERSIST_MAGIC || persist.crc != persist_crc() || reason == ESP_RST_POWERON) {
+        memset(&persist, 0, sizeof(persist));
+        persist.magic = PERSIST_MAGIC;
+        persist.min_heap = UINT32_MAX;
+    }
+    else {
+        persist.last_uptime_s = persist.uptime_s;
+        persist.uptime_total_s += persist.uptime_s;
+    }
+    persist.boot_count++;
+    persist.uptime_s = 0;
+    persist.reset_reason = reason;
+    persist.reset_reason_count[reason < PERSIST_RESET_REASONS ? reason : 0]++;
+    persist.crc = persist_crc();
+
+    persist_stats_print();
+}
+
+void persist_stats_update(uint32_t uptime_s, uint32_t new_underruns, uint32_t cb_latency_us, uint32_t min_heap) {
+    portENTER_CRITICAL(&persist_lock);
+    persist.uptime_s = uptime_s;
+    persist.underruns += new_underruns;
+    if (cb_latency_us > persist.max_cb_latency_us) persist.max_cb_latency_us = cb_latency_us;
+    if (min_heap < persist.min_heap) persist.min_heap = min_heap;
+    persist.crc = persist_crc();
+    portEXIT_CRITICAL(&persist_lock);
+}
+
+void persist_stats_add_recovery(uint8_t level) {
+    portENTER_CRITICAL(&persist_lock);
+    persist.recoveries[level < PERSIST_RECOVERY_LEVELS ? level : PERSIST_RECOVERY_LEVELS - 1]++;
+    persist.crc = persist_crc();
+    portEXIT_CRITICAL(&persist_lock);
+}
+
+void persist_stats_get(persist_stats_t *stats) {
+    portENTER_CRITICAL(&persist_lock);
+    *stats = persist;
+    portEXIT_CRITICAL(&persist_lock);
+}
+
+void persist_stats_clear() {
+    portENTER_CRITICAL(&persist_lock);
+    uint32_t reason = persist.reset_reason;
+    memset(&persist, 0, sizeof(persist));
+    persist.magic = PERSIST_MAGIC;
+    persist.min_heap = UINT32_MAX;
+    persist.boot_count = 1;
+    persist.reset_reason = reason;
+    persist.crc = persist_crc();
+    portEXIT_CRITICAL(&persist_lock);
+}
+
+void persist_stats_print() {
+    persist_stats_t p;
+    persist_stats_get(&p);
+
+    ESP_LOGI(TAG, "boot %u, reset reason: %s, previous uptime: %u s, total uptime: %llu s",
+             p.boot_count, reason_str(p.reset_reason), p.last_uptime_s, p.uptime_total_s + p.uptime_s);
+    ESP_LOGI(TAG, "underruns: %u  max data callback: %u us  min heap: %u",
+             p.underruns, p.max_cb_latency_us, p.min_heap == UINT32_MAX ? 0 : p.min_heap);
+    ESP_LOGI(TAG, "pipeline recoveries: flush %u  restart %u  reboot %u",
+             p.recoveries[0], p.recoveries[1], p.recoveries[2]);
+    for (uint8_t i = 0; i < PERSIST_RESET_REASONS; i++) {
+        if (p.reset_reason_count[i]) ESP_LOGI(TAG, "  resets by %s: %u", reason_str(i), p.reset_reason_count[i]);
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+
+/*
+ * Counters kept in RTC memory (RTC_NOINIT), they survive software resets, watchdog and
+ * brownout resets but not a power cycle. No flash writes are involved.
+ */
+
+#include <stdint.h>
+
+#define PERSIST_RESET_REASONS   16
+#define PERSIST_RECOVERY_LEVELS 3
+
+typedef struct {
+    uint32_t magic;
+    uint32_t boot_count;
+    uint32_t reset_reason;                          /*!< esp_reset_reason_t of the current boot */
+    uint32_t reset_reason_count[PERSIST_RESET_REASONS];
+    uint32_t underruns;                             /*!< cumulative over all boots */
+    uint32_t max_cb_latency_us;                     /*!< longest bluetooth data callback */
+    uint32_t min_heap;                              /*!< minimum free heap ever */
+    uint32_t uptime_s;                              /*!< uptime of the current boot */
+    uint32_t last_uptime_s;                         /*!< uptime of the previous boot when it reset */
+    uint64_t uptime_total_s;                        /*!< cumulative uptime of previous boots */
+    uint32_t recoveries[PERSIST_RECOVERY_LEVELS];   /*!< pipeline watchdog recoveries by level */
+    uint32_t crc;
+} persist_stats_t;
+
+
+/**
+ * @brief     validate or clear the RTC block, count this boot and log the history
+ */
+void persist_stats_init();
+
+/**
+ * @brief     periodic update from the metrics task
+ */
+void persist_stats_update(uint32_t uptime_s, uint32_t new_underruns, uint32_t cb_latency_us, uint32_t min_heap);
+
+/**
+ * @brief     count a pipeline watchdog recovery of the given level (0 flush, 1 restart, 2 reboot)
+ */
+void persist_stats_add_recovery(uint8_t level);
+
+void persist_stats_get(persist_stats_t *stats);
+
+/**
+ * @brief     clear all counters
+ */
+void persist_stats_clear();
+
+void persist_stats_print();
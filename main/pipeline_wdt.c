@@ -0,0 +1,132 @@
+#include <stdbool.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#include "bt_app_core.h"
+#include "bt_app_av.h"
+#include "audio_stats.h"
+#include "persist_stats.h"
+#include "pipeline_wdt.h"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-variable"
+static const char *TAG = "PIPE_WDT";
+#pragma GCC diagnostic pop
+
+#define PIPELINE_WDT_CHECK_MS   250
+
+static uint32_t s_input_stalls = 0;
+static uint32_t s_output_stalls = 0;
+
+static const char *action_str[] = { "flush", "restart", "reboot" };
+
+
+static void pipeline_wdt_recover(pipeline_wdt_action_t action) {
+    ESP_LOGE(TAG, "output stalled, recovery: %s", action_str[action]);
+    persist_stats_add_recovery(action);
+
+    switch (action) {
+    case PIPELINE_WDT_FLUSH:
+        bt_i2s_flush();
+        break;
+    case PIPELINE_WDT_RESTART:
+        bt_i2s_task_restart();
+        break;
+    case PIPELINE_WDT_REBOOT:
+        esp_restart();
+        break;
+    }
+}
+
+static void pipeline_wdt_task(void *arg) {
+    const int64_t timeout_us = CONFIG_PIPELINE_WDT_TIMEOUT_MS * 1000LL;
+    TickType_t last_wake = xTaskGetTickCount();
+    bt_i2s_counters_t i2s;
+    uint32_t last_pkt_cnt = 0;
+    uint64_t last_bytes_out = 0;
+    int64_t input_progress_us = 0;
+    int64_t output_progress_us = 0;
+    bool input_stalled = false;
+    bool active = false;
+    int level = 0;
+
+    for (;;) {
+        vTaskDelayUntil(&last_wake, PIPELINE_WDT_CHECK_MS / portTICK_PERIOD_MS);
+        int64_t now = esp_timer_get_time();
+
+        if (!audio_stats_active()) {
+            active = false;
+            level = 0;
+            continue;
+        }
+
+        uint32_t pkt_cnt = bt_app_get_pkt_cnt();
+        bt_i2s_get_counters(&i2s);
+        if (!active) {
+            //give a new session a full timeout before judging it
+            active = true;
+            input_stalled = false;
+            input_progress_us = output_progress_us = now;
+            last_pkt_cnt = pkt_cnt;
+            last_bytes_out = i2s.bytes_out;
+            continue;
+        }
+
+        if (pkt_cnt != last_pkt_cnt) {
+            last_pkt_cnt = pkt_cnt;
+            input_progress_us = now;
+            if (input_stalled) ESP_LOGI(TAG, "input resumed");
+            input_stalled = false;
+        }
+        if (i2s.bytes_out != last_bytes_out) {
+            last_bytes_out = i2s.bytes_out;
+            output_progress_us = now;
+            if (level) ESP_LOGI(TAG, "output resumed");
+            level = 0;
+        }
+
+        //the source stopped sending without leaving the started state, nothing to recover here
+        if (!input_stalled && now - input_progress_us > timeout_us) {
+            input_stalled = true;
+            s_input_stalls++;
+            ESP_LOGW(TAG, "no packets for %lld ms", (now - input_progress_us) / 1000);
+        }
+
+        //output is stalled if data is waiting but none leaves the ring, or i2s_write does not return.
+        //the ring itself tells, byte counters drift apart for good when a restart or disconnect drops data
+        int64_t write_started = bt_i2s_write_started_us();
+        bool data_waiting = bt_i2s_ringbuf_fill() > 0;
+        if ((data_waiting && now - output_progress_us > timeout_us) ||
+            (write_started && now - write_started > timeout_us)) {
+            s_output_stalls++;
+            pipeline_wdt_recover(level);
+            if (level < PIPELINE_WDT_REBOOT) level++;
+            output_progress_us = esp_timer_get_time();
+        }
+    }
+}
+
+void pipeline_wdt_start() {
+    //above the i2s task so a busy pipeline can not starve the check
+    xTaskCreate(
+        pipeline_wdt_task,      /* Task function. */
+        "PipelineWdt",          /* String with name of task. */
+        2560,                   /* Stack size in bytes. */
+        NULL,                   /* Parameter passed as input of the task */
+        configMAX_PRIORITIES - 2,   /* Priority of the task. */
+        NULL
+    );                          /* Task handle. */
+}
+
+uint32_t pipeline_wdt_input_stalls() {
+    return s_input_stalls;
+}
+
+uint32_t pipeline_wdt_output_stalls() {
+    return s_output_stalls;
+}
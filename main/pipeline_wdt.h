@@ -0,0 +1,28 @@
+#pragma once
+
+
+/*
+ * Audio pipeline stall watchdog. While the A2DP audio state is started it checks that
+ * data keeps moving from the bluetooth data callback through the ring buffer into the
+ * i2s DMA. A stalled output stage is recovered in escalating steps: flush the i2s DMA,
+ * restart ring buffer, i2s task and driver, reboot.
+ */
+
+#include <stdint.h>
+
+typedef enum {
+    PIPELINE_WDT_FLUSH = 0,
+    PIPELINE_WDT_RESTART,
+    PIPELINE_WDT_REBOOT,
+} pipeline_wdt_action_t;
+
+/**
+ * @brief     start the pipeline watchdog task
+ */
+void pipeline_wdt_start();
+
+/**
+ * @brief     number of stalls detected since boot, input stalls are only counted
+ */
+uint32_t pipeline_wdt_input_stalls();
+uint32_t pipeline_wdt_output_stalls();
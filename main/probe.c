@@ -0,0 +1,111 @@
+#include <string.h>
+#include <stdio.h>
+
+#include "probe.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_log.h"
+#include "esp32/clk.h"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-variable"
+static const char *TAG = "PROBE";
+#pragma GCC diagnostic pop
+
+#define PROBE_PRINT(fmt, ...)   ESP_LOGI(TAG, fmt, ##__VA_ARGS__)
+#else
+#define PROBE_PRINT(fmt, ...)   printf(fmt "\n", ##__VA_ARGS__)
+#endif
+
+
+static const char *probe_names[PROBE_MAX] = {
+    "a2d_data_cb", "write_ringbuf", "i2s_write", "render_vu_meter", "fb_show"
+};
+
+static probe_hist_t probes[PROBE_MAX];
+
+
+static uint16_t bucket_of(uint32_t ticks) {
+    if (ticks < (1 << PROBE_SUB_BITS)) return ticks;
+    uint8_t msb = 31 - __builtin_clz(ticks);
+    uint8_t sub = (ticks >> (msb - PROBE_SUB_BITS)) & ((1 << PROBE_SUB_BITS) - 1);
+    return ((msb - PROBE_SUB_BITS + 1) << PROBE_SUB_BITS) | sub;
+}
+
+uint32_t probe_bucket_limit(uint16_t bucket) {
+    if (bucket < (1 << PROBE_SUB_BITS)) return bucket;
+    uint8_t msb = (bucket >> PROBE_SUB_BITS) + PROBE_SUB_BITS - 1;
+    uint64_t sub = bucket & ((1 << PROBE_SUB_BITS) - 1);
+    uint64_t limit = ((1ull << PROBE_SUB_BITS | sub) + 1) << (msb - PROBE_SUB_BITS);
+    return limit - 1 > UINT32_MAX ? UINT32_MAX : limit - 1;
+}
+
+float probe_ticks_per_us() {
+#ifdef ESP_PLATFORM
+    return esp_clk_cpu_freq() / 1000000.0;
+#else
+    return 1000.0;
+#endif
+}
+
+void probe_record(probe_id_t id, uint32_t ticks) {
+    probe_hist_t *h = &probes[id];
+    if (h->count == 0 || ticks < h->min) h->min = ticks;
+    if (ticks > h->max) h->max = ticks;
+    h->sum += ticks;
+    h->count++;
+    h->bucket[bucket_of(ticks)]++;
+}
+
+void probe_reset() {
+    memset(probes, 0, sizeof(probes));
+}
+
+static uint32_t percentile(const probe_hist_t *h, uint32_t permille) {
+    uint64_t rank = ((uint64_t)h->count * permille + 999) / 1000;
+    uint64_t seen = 0;
+    for (uint16_t b = 0; b < PROBE_BUCKETS; b++) {
+        seen += h->bucket[b];
+        if (seen >= rank) {
+            uint32_t limit = probe_bucket_limit(b);
+            return limit > h->max ? h->max : limit;
+        }
+    }
+    return h->max;
+}
+
+void probe_summary(probe_id_t id, probe_summary_t *summary) {
+    //copy first, the probe may be recording concurrently
+    static probe_hist_t h;
+    float scale = probe_ticks_per_us();
+    memcpy(&h, &probes[id], sizeof(h));
+    memset(summary, 0, sizeof(probe_summary_t));
+    if (h.count == 0) return;
+    summary->count = h.count;
+    summary->min_us = h.min / scale;
+    summary->max_us = h.max / scale;
+    summary->avg_us = h.sum / h.count / scale;
+    summary->p50_us = percentile(&h, 500) / scale;
+    summary->p99_us = percentile(&h, 990) / scale;
+}
+
+const probe_hist_t *probe_hist(probe_id_t id) {
+    return &probes[id];
+}
+
+const char *probe_name(probe_id_t id) {
+    return id < PROBE_MAX ? probe_names[id] : "?";
+}
+
+void probe_dump() {
+    probe_summary_t s;
+#if !CONFIG_PROBE_ENABLE
+    PROBE_PRINT("probes disabled, enable CONFIG_PROBE_ENABLE");
+#endif
+    PROBE_PRINT("%-16s %8s %9s %9s %9s %9s %9s", "probe", "count", "min us", "avg us", "p50 us", "p99 us", "max us");
+    for (uint8_t i = 0; i < PROBE_MAX; i++) {
+        probe_summary(i, &s);
+        PROBE_PRINT("%-16s %8u %9.1f %9.1f %9.1f %9.1f %9.1f", probe_names[i], (unsigned)s.count,
+                    s.min_us, s.avg_us, s.p50_us, s.p99_us, s.max_us);
+    }
+}
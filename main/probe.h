@@ -0,0 +1,103 @@
+#pragma once
+
+
+/*
+ * Lightweight latency probes for the hot paths. Timestamps come from the Xtensa CCOUNT
+ * cycle counter on target and from clock_gettime on the host build. With CONFIG_PROBE_ENABLE
+ * unset the macros compile to nothing. CCOUNT is per core, a probe spanning a blocking call
+ * needs a task pinned to one core.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#include "xtensa/hal.h"
+#else
+#include <time.h>
+#endif
+
+
+typedef enum {
+    PROBE_A2D_DATA_CB = 0,
+    PROBE_WRITE_RINGBUF,
+    PROBE_I2S_WRITE,
+    PROBE_RENDER_VU,
+    PROBE_FB_SHOW,
+    PROBE_MAX
+} probe_id_t;
+
+//log2 buckets with 4 linear sub buckets each, covers the full 32 bit range
+#define PROBE_SUB_BITS          2
+#define PROBE_BUCKETS           ((32 - PROBE_SUB_BITS + 1) << PROBE_SUB_BITS)
+
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t bucket[PROBE_BUCKETS];
+} probe_hist_t;
+
+typedef struct {
+    uint32_t count;
+    float min_us;
+    float max_us;
+    float avg_us;
+    float p50_us;
+    float p99_us;
+} probe_summary_t;
+
+
+static inline uint32_t probe_now() {
+#ifdef ESP_PLATFORM
+    return xthal_get_ccount();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec);
+#endif
+}
+
+#if CONFIG_PROBE_ENABLE
+#define PROBE_START(id)         uint32_t _probe_start_##id = probe_now()
+#define PROBE_STOP(id)          probe_record(id, probe_now() - _probe_start_##id)
+#else
+#define PROBE_START(id)
+#define PROBE_STOP(id)
+#endif
+
+
+/**
+ * @brief     add one measurement in probe ticks (cpu cycles on target, ns on host)
+ */
+void probe_record(probe_id_t id, uint32_t ticks);
+
+/**
+ * @brief     probe ticks per us, the cpu clock on target and 1000 on host
+ */
+float probe_ticks_per_us();
+
+/**
+ * @brief     clear all histograms
+ */
+void probe_reset();
+
+/**
+ * @brief     min, max, average and percentiles of a probe in us
+ */
+void probe_summary(probe_id_t id, probe_summary_t *summary);
+
+/**
+ * @brief     raw histogram of a probe, bucket upper bounds come from probe_bucket_limit()
+ */
+const probe_hist_t *probe_hist(probe_id_t id);
+uint32_t probe_bucket_limit(uint16_t bucket);
+
+const char *probe_name(probe_id_t id);
+
+/**
+ * @brief     print a summary line per probe
+ */
+void probe_dump();
@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "rt_log.h"
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define RT_LOG_NOW_MS()         esp_log_timestamp()
+#define RT_LOG_OUTPUT(level, tag, fmt, ...) ESP_LOG_LEVEL(level, tag, fmt, ##__VA_ARGS__)
+#else
+#include <time.h>
+
+static uint32_t rt_log_now_host() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+#define RT_LOG_NOW_MS()         rt_log_now_host()
+#define RT_LOG_OUTPUT(level, tag, fmt, ...) printf("%s: " fmt "\n", tag, ##__VA_ARGS__)
+#endif
+
+#define RT_LOG_POLL_MS          20
+
+
+typedef struct {
+    uint32_t seq;               /*!< index + 1 once the record is complete */
+    uint32_t ms;
+    const char *tag;
+    const char *fmt;
+    uint32_t args[RT_LOG_ARGS];
+    uint32_t suppressed;
+    uint8_t level;
+} rt_log_record_t;
+
+static rt_log_record_t records[RT_LOG_RECORDS];
+static uint32_t head = 0;
+static uint32_t tail = 0;
+static uint32_t dropped = 0;
+
+
+void rt_log_write(rt_log_site_t *site, esp_log_level_t level, const char *tag, uint32_t interval_ms,
+                  const char *fmt, const uint32_t *args) {
+    uint32_t now = RT_LOG_NOW_MS();
+    if (site->used && now - site->last_ms < interval_ms) {
+        site->suppressed++;
+        return;
+    }
+
+    uint32_t h = __atomic_load_n(&head, __ATOMIC_RELAXED);
+    do {
+        if (h - __atomic_load_n(&tail, __ATOMIC_ACQUIRE) >= RT_LOG_RECORDS) {
+            __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+            site->suppressed++;
+            return;
+        }
+    } while (!__atomic_compare_exchange_n(&head, &h, h + 1, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+    rt_log_record_t *r = &records[h % RT_LOG_RECORDS];
+    r->ms = now;
+    r->tag = tag;
+    r->fmt = fmt;
+    memcpy(r->args, args, sizeof(r->args));
+    r->suppressed = site->suppressed;
+    r->level = level;
+    __atomic_store_n(&r->seq, h + 1, __ATOMIC_RELEASE);
+
+    site->used = true;
+    site->last_ms = now;
+    site->suppressed = 0;
+}
+
+uint32_t rt_log_flush() {
+    static char line[128];
+    uint32_t printed = 0;
+    uint32_t t = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+
+    for (;;) {
+        rt_log_record_t *r = &records[t % RT_LOG_RECORDS];
+        if (__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) != t + 1) break;
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+        snprintf(line, sizeof(line), r->fmt, r->args[0], r->args[1], r->args[2], r->args[3]);
+#pragma GCC diagnostic pop
+        if (r->suppressed) {
+            RT_LOG_OUTPUT(r->level, r->tag, "@%u %s (%u suppressed)", (unsigned)r->ms, line, (unsigned)r->suppressed);
+        }
+        else {
+            RT_LOG_OUTPUT(r->level, r->tag, "@%u %s", (unsigned)r->ms, line);
+        }
+        t++;
+        __atomic_store_n(&tail, t, __ATOMIC_RELEASE);
+        printed++;
+    }
+    return printed;
+}
+
+uint32_t rt_log_dropped() {
+    return __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+}
+
+#ifdef ESP_PLATFORM
+static void rt_log_task(void *arg) {
+    for (;;) {
+        rt_log_flush();
+        vTaskDelay(RT_LOG_POLL_MS / portTICK_PERIOD_MS);
+    }
+}
+
+void rt_log_start() {
+    xTaskCreate(
+        rt_log_task,            /* Task function. */
+        "RtLog",                /* String with name of task. */
+        2560,                   /* Stack size in bytes. */
+        NULL,                   /* Parameter passed as input of the task */
+        1,                      /* Priority of the task. */
+        NULL
+    );                          /* Task handle. */
+}
+#endif
@@ -0,0 +1,62 @@
+#pragma once
+
+
+/*
+ * Real-time safe logging for the audio callbacks. A call only stores the format pointer and
+ * up to 4 integer arguments in a lock-free ring, formatting and the UART output happen in
+ * a low priority task. Every call site is rate limited, suppressed calls are counted and
+ * reported with the next record of the same site.
+ *
+ * Format strings must be literals and may only use 32 bit integer conversions (%d %u %x %c).
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#include "esp_log.h"
+#define RT_LOG_MIN_INTERVAL_MS  CONFIG_RT_LOG_MIN_INTERVAL_MS
+#else
+#define RT_LOG_MIN_INTERVAL_MS  1000
+typedef enum { ESP_LOG_NONE, ESP_LOG_ERROR, ESP_LOG_WARN, ESP_LOG_INFO, ESP_LOG_DEBUG, ESP_LOG_VERBOSE } esp_log_level_t;
+#endif
+
+#define RT_LOG_RECORDS          32
+#define RT_LOG_ARGS             4
+
+typedef struct {
+    uint32_t last_ms;
+    uint32_t suppressed;
+    bool used;
+} rt_log_site_t;
+
+
+#define RT_LOG_RATE(level, tag, interval_ms, fmt, ...) do {                                 \
+        static rt_log_site_t _rt_log_site;                                                  \
+        rt_log_write(&_rt_log_site, level, tag, interval_ms, fmt,                           \
+                     (const uint32_t[RT_LOG_ARGS + 1]){ 0, ##__VA_ARGS__ } + 1);            \
+    } while (0)
+
+#define RT_LOGE(tag, fmt, ...)  RT_LOG_RATE(ESP_LOG_ERROR, tag, RT_LOG_MIN_INTERVAL_MS, fmt, ##__VA_ARGS__)
+#define RT_LOGW(tag, fmt, ...)  RT_LOG_RATE(ESP_LOG_WARN, tag, RT_LOG_MIN_INTERVAL_MS, fmt, ##__VA_ARGS__)
+#define RT_LOGI(tag, fmt, ...)  RT_LOG_RATE(ESP_LOG_INFO, tag, RT_LOG_MIN_INTERVAL_MS, fmt, ##__VA_ARGS__)
+
+
+void rt_log_write(rt_log_site_t *site, esp_log_level_t level, const char *tag, uint32_t interval_ms,
+                  const char *fmt, const uint32_t *args);
+
+/**
+ * @brief     format and print all pending records, returns number printed
+ */
+uint32_t rt_log_flush();
+
+/**
+ * @brief     records lost because the ring was full
+ */
+uint32_t rt_log_dropped();
+
+/**
+ * @brief     start the low priority output task
+ */
+void rt_log_start();
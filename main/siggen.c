@@ -0,0 +1,309 @@
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "siggen.h"
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#include "bt_app_core.h"
+#include "bt_app_av.h"
+#include "audio_stats.h"
+#include "display.h"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-variable"
+static const char *TAG = "SIGGEN";
+#pragma GCC diagnostic pop
+#endif
+
+#define SINE_SIZE       (1 << SIGGEN_SINE_BITS)
+
+static const char *type_names[SIGGEN_MAX] = { "silence", "sine", "sweep", "pink", "impulse" };
+
+//one period plus the first sample again for the interpolation
+static int16_t sine_table[SINE_SIZE + 1];
+
+
+static void sine_table_init() {
+    if (sine_table[SINE_SIZE / 4]) return;
+    for (int i = 0; i <= SINE_SIZE; i++) {
+        sine_table[i] = (int16_t)lround(32767 * sin(2 * M_PI * i / SINE_SIZE));
+    }
+}
+
+static uint32_t phase_inc(float freq, uint32_t sample_rate) {
+    return (uint32_t)(freq * 4294967296.0 / sample_rate);
+}
+
+static uint32_t rng_next(siggen_t *gen) {
+    //xorshift32
+    gen->rng ^= gen->rng << 13;
+    gen->rng ^= gen->rng >> 17;
+    gen->rng ^= gen->rng << 5;
+    return gen->rng;
+}
+
+void siggen_default_config(siggen_config_t *cfg) {
+    cfg->type = SIGGEN_SINE;
+    cfg->sample_rate = 44100;
+    cfg->freq = 1000;
+    cfg->freq_end = 20000;
+    cfg->sweep_s = 10;
+    cfg->level_db = -6;
+    cfg->seed = 1;
+}
+
+bool siggen_config_valid(const siggen_config_t *cfg) {
+    float nyquist = cfg->sample_rate / 2.0f;
+
+    //written as in range checks so NaN fails them too
+    if (cfg->sample_rate < SIGGEN_RATE_MIN || cfg->sample_rate > SIGGEN_RATE_MAX) return false;
+    if (!(cfg->level_db >= SIGGEN_LEVEL_MIN && cfg->level_db <= 0)) return false;
+    switch (cfg->type) {
+    case SIGGEN_SINE:
+        return cfg->freq > 0 && cfg->freq < nyquist;
+    case SIGGEN_SWEEP:
+        return cfg->freq > 0 && cfg->freq < nyquist && cfg->freq_end > 0 && cfg->freq_end < nyquist && cfg->sweep_s > 0;
+    case SIGGEN_IMPULSE:
+        return cfg->freq > 0 && cfg->freq <= cfg->sample_rate;
+    default:
+        return true;
+    }
+}
+
+void siggen_init(siggen_t *gen, const siggen_config_t *cfg) {
+    memset(gen, 0, sizeof(*gen));
+    gen->cfg = *cfg;
+    gen->amplitude = (int32_t)lround(32767 * pow(10, (cfg->level_db > 0 ? 0 : cfg->level_db) / 20));
+    gen->rng = cfg->seed ? cfg->seed : 1;
+    sine_table_init();
+
+    switch (cfg->type) {
+    case SIGGEN_SINE:
+        gen->phase_inc = phase_inc(cfg->freq, cfg->sample_rate);
+        break;
+    case SIGGEN_SWEEP:
+        gen->period = (uint32_t)(cfg->sweep_s * cfg->sample_rate);
+        if (gen->period == 0) gen->period = 1;
+        gen->inc = phase_inc(cfg->freq, cfg->sample_rate);
+        gen->sweep_k = pow(cfg->freq_end / cfg->freq, 1.0 / gen->period);
+        break;
+    case SIGGEN_PINK:
+        for (int i = 0; i < SIGGEN_PINK_ROWS; i++) {
+            gen->pink_rows[i] = (int16_t)rng_next(gen) >> 4;
+            gen->pink_sum += gen->pink_rows[i];
+        }
+        break;
+    case SIGGEN_IMPULSE:
+        gen->period = cfg->freq > 0 ? (uint32_t)(cfg->sample_rate / cfg->freq) : cfg->sample_rate;
+        if (gen->period == 0) gen->period = 1;
+        break;
+    default:
+        break;
+    }
+}
+
+static int32_t sine_sample(siggen_t *gen) {
+    uint32_t i = gen->phase >> (32 - SIGGEN_SINE_BITS);
+    int32_t frac = (gen->phase >> (16 - SIGGEN_SINE_BITS)) & 0xffff;
+    int32_t s = sine_table[i] + (((sine_table[i + 1] - sine_table[i]) * frac) >> 16);
+    return s * gen->amplitude >> 15;
+}
+
+static int32_t next_sample(siggen_t *gen) {
+    int32_t s = 0;
+
+    switch (gen->cfg.type) {
+    case SIGGEN_SINE:
+        s = sine_sample(gen);
+        gen->phase += gen->phase_inc;
+        break;
+    case SIGGEN_SWEEP:
+        s = sine_sample(gen);
+        gen->phase += (uint32_t)gen->inc;
+        gen->inc *= gen->sweep_k;
+        if (++gen->pos >= gen->period) {
+            gen->pos = 0;
+            gen->inc = phase_inc(gen->cfg.freq, gen->cfg.sample_rate);
+        }
+        break;
+    case SIGGEN_PINK: {
+        //Voss-McCartney: row n changes every 2^n samples
+        uint32_t row = __builtin_ctz(++gen->counter | 1u << (SIGGEN_PINK_ROWS - 1));
+        int32_t value = (int16_t)rng_next(gen) >> 4;
+        gen->pink_sum += value - gen->pink_rows[row];
+        gen->pink_rows[row] = value;
+        s = gen->pink_sum * gen->amplitude >> 15;
+        break;
+    }
+    case SIGGEN_IMPULSE:
+        s = gen->pos == 0 ? gen->amplitude : 0;
+        if (++gen->pos >= gen->period) gen->pos = 0;
+        break;
+    default:
+        break;
+    }
+    return s > 32767 ? 32767 : s < -32768 ? -32768 : s;
+}
+
+void siggen_fill(siggen_t *gen, uint8_t *data, size_t len) {
+    for (size_t i = 0; i + 4 <= len; i += 4) {
+        int32_t s = next_sample(gen);
+        data[i] = data[i + 2] = (uint8_t)s;
+        data[i + 1] = data[i + 3] = (uint8_t)(s >> 8);
+    }
+}
+
+const char *siggen_type_name(siggen_type_t type) {
+    return type < SIGGEN_MAX ? type_names[type] : "?";
+}
+
+siggen_type_t siggen_type(const char *name) {
+    for (int t = 0; t < SIGGEN_MAX; t++) {
+        if (strcmp(name, type_names[t]) == 0) return t;
+    }
+    return SIGGEN_MAX;
+}
+
+
+#ifdef ESP_PLATFORM
+static siggen_t s_gen;
+static uint8_t *s_packet = NULL;
+static uint32_t s_packet_bytes;
+static TaskHandle_t s_task = NULL;
+static volatile bool s_stop = false;
+static esp_timer_handle_t s_timer = NULL;
+static bool s_started_i2s = false;
+//start and stop come from the console and, when a phone connects, from the BT app task
+static StaticSemaphore_t s_mutex_buf;
+static SemaphoreHandle_t s_mutex = NULL;
+
+static void siggen_timer_cb(void *arg) {
+    xTaskNotifyGive(s_task);
+}
+
+static void siggen_task(void *arg) {
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (s_stop) break;
+        siggen_fill(&s_gen, s_packet, s_packet_bytes);
+        bt_app_a2d_data_cb(s_packet, s_packet_bytes);
+    }
+    //never delete the task from outside, it may be blocked in the ring buffer write
+    s_task = NULL;
+    vTaskDelete(NULL);
+}
+
+void siggen_source_init() {
+    s_mutex = xSemaphoreCreateMutexStatic(&s_mutex_buf);
+}
+
+static void source_stop() {
+    if (s_timer) {
+        esp_timer_stop(s_timer);
+        esp_timer_delete(s_timer);
+        s_timer = NULL;
+    }
+    if (s_task) {
+        s_stop = true;
+        xTaskNotifyGive(s_task);
+        while (s_task) vTaskDelay(10 / portTICK_PERIOD_MS);
+        audio_stats_session_stop();
+        display_streaming(false);
+    }
+    if (s_started_i2s) {
+        bt_i2s_task_shut_down();
+        s_started_i2s = false;
+    }
+    free(s_packet);
+    s_packet = NULL;
+}
+
+static esp_err_t source_start(const siggen_config_t *cfg, uint32_t packet_bytes) {
+    esp_err_t err;
+
+    //the i2s clock, ring buffer and data callback belong to the phone while it is connected
+    if (bt_app_a2d_connected()) return ESP_ERR_INVALID_STATE;
+    packet_bytes &= ~3u;
+    if (!siggen_config_valid(cfg) || packet_bytes < SIGGEN_PACKET_MIN || packet_bytes > SIGGEN_PACKET_MAX) return ESP_ERR_INVALID_ARG;
+    source_stop();
+
+    //from here on siggen_source_stop() undoes whatever got started
+    s_packet = malloc(packet_bytes);
+    if (s_packet == NULL) return ESP_ERR_NO_MEM;
+    s_packet_bytes = packet_bytes;
+    siggen_init(&s_gen, cfg);
+
+    const esp_timer_create_args_t timer_args = { .callback = &siggen_timer_cb, .name = "siggen" };
+    err = esp_timer_create(&timer_args, &s_timer);
+    if (err != ESP_OK) {
+        s_timer = NULL;
+        source_stop();
+        return err;
+    }
+
+    if (!bt_i2s_task_running()) {
+        bt_i2s_task_start_up();
+        s_started_i2s = true;
+        if (!bt_i2s_task_running()) {
+            source_stop();
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    err = bt_i2s_set_sample_rate(cfg->sample_rate);
+    if (err != ESP_OK) {
+        source_stop();
+        return err;
+    }
+    s_stop = false;
+
+    //same priority and core as the bluedroid task that calls the data callback, its probes span the ring buffer write
+    if (xTaskCreatePinnedToCore(
+        siggen_task,            /* Task function. */
+        "SigGen",               /* String with name of task. */
+        3072,                   /* Stack size in bytes. */
+        NULL,                   /* Parameter passed as input of the task */
+        configMAX_PRIORITIES - 6,   /* Priority of the task. */
+        &s_task,                /* Task handle. */
+        CONFIG_BT_BLUEDROID_PINNED_TO_CORE  /* Core. */
+    ) != pdPASS) {
+        s_task = NULL;
+        source_stop();
+        return ESP_ERR_NO_MEM;
+    }
+    audio_stats_session_start(esp_timer_get_time());
+    display_streaming(true);
+
+    err = esp_timer_start_periodic(s_timer, (uint64_t)packet_bytes / 4 * 1000000 / cfg->sample_rate);
+    if (err != ESP_OK) {
+        source_stop();
+        return err;
+    }
+    ESP_LOGI(TAG, "%s source, %u Hz, packets of %u bytes", siggen_type_name(cfg->type), cfg->sample_rate, packet_bytes);
+    return ESP_OK;
+}
+
+esp_err_t siggen_source_start(const siggen_config_t *cfg, uint32_t packet_bytes) {
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    esp_err_t err = source_start(cfg, packet_bytes);
+    xSemaphoreGive(s_mutex);
+    return err;
+}
+
+void siggen_source_stop() {
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    source_stop();
+    xSemaphoreGive(s_mutex);
+}
+
+bool siggen_source_running() {
+    return s_task != NULL;
+}
+#endif
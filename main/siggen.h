@@ -0,0 +1,101 @@
+#pragma once
+
+
+/*
+ * Test signal generator, produces 16 bit stereo PCM like the A2DP decoder. The generator is
+ * portable, on the target it can also run as a source that feeds bt_app_a2d_data_cb with
+ * packets timed like A2DP, so the pipeline can be measured without a phone.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define SIGGEN_PINK_ROWS        16
+#define SIGGEN_SINE_BITS        10                  /*!< 1024 entry sine table */
+#define SIGGEN_RATE_MIN         8000
+#define SIGGEN_RATE_MAX         96000
+#define SIGGEN_LEVEL_MIN        -100                /*!< dBFS */
+
+typedef enum {
+    SIGGEN_SILENCE = 0,
+    SIGGEN_SINE,
+    SIGGEN_SWEEP,                                   /*!< logarithmic sweep freq to freq_end, repeated */
+    SIGGEN_PINK,
+    SIGGEN_IMPULSE,                                 /*!< freq impulses per second */
+    SIGGEN_MAX
+} siggen_type_t;
+
+typedef struct {
+    siggen_type_t type;
+    uint32_t sample_rate;
+    float freq;
+    float freq_end;
+    float sweep_s;
+    float level_db;                                 /*!< dBFS, <= 0 */
+    uint32_t seed;
+} siggen_config_t;
+
+typedef struct {
+    siggen_config_t cfg;
+    int32_t amplitude;
+    uint32_t phase;
+    uint32_t phase_inc;
+    double inc;                                     /*!< sweep: current phase increment */
+    double sweep_k;                                 /*!< sweep: increment factor per sample, in float the sweep ends 2% short */
+    uint32_t pos;                                   /*!< samples into the sweep or impulse period */
+    uint32_t period;                                /*!< samples of one sweep or impulse period */
+    uint32_t rng;
+    uint32_t counter;
+    int32_t pink_rows[SIGGEN_PINK_ROWS];
+    int32_t pink_sum;
+} siggen_t;
+
+/**
+ * @brief     default config: 1 kHz sine at -6 dBFS, 44.1 kHz, sweep 20 Hz to 20 kHz in 10 s
+ */
+void siggen_default_config(siggen_config_t *cfg);
+
+/**
+ * @brief     sample rate, level and the frequencies the type uses are in range, below half the rate for tones
+ */
+bool siggen_config_valid(const siggen_config_t *cfg);
+
+void siggen_init(siggen_t *gen, const siggen_config_t *cfg);
+
+/**
+ * @brief     fill len bytes with interleaved little endian 16 bit stereo, both channels equal
+ */
+void siggen_fill(siggen_t *gen, uint8_t *data, size_t len);
+
+const char *siggen_type_name(siggen_type_t type);
+
+/**
+ * @brief     type by name, SIGGEN_MAX if unknown
+ */
+siggen_type_t siggen_type(const char *name);
+
+#ifdef ESP_PLATFORM
+#include "esp_err.h"
+
+/* packets of at least 64 frames keep the timer period far above the esp_timer minimum,
+ * doubled to 32 bit the largest still fits the ring buffer of the low latency profile */
+#define SIGGEN_PACKET_MIN       256
+#define SIGGEN_PACKET_MAX       4096
+
+/** @brief creates the lock serializing start and stop, before the bluetooth stack runs */
+void siggen_source_init();
+
+/**
+ * @brief     feed generated packets of packet_bytes into bt_app_a2d_data_cb at the A2DP rate
+ *
+ * Starts ring buffer and i2s task and sets their sample rate. Fails with ESP_ERR_INVALID_STATE while an
+ * A2DP connection exists, a connecting phone stops the source, and with
+ * ESP_ERR_INVALID_ARG for an invalid config or packet_bytes outside SIGGEN_PACKET_MIN..SIGGEN_PACKET_MAX.
+ */
+esp_err_t siggen_source_start(const siggen_config_t *cfg, uint32_t packet_bytes);
+
+void siggen_source_stop();
+
+bool siggen_source_running();
+#endif
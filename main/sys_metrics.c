@@ -0,0 +1,177 @@
+#include <stdbool.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_task_wdt.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#include "bt_app_core.h"
+#include "bt_app_av.h"
+#include "boot_time.h"
+#include "task_stats.h"
+#include "probe.h"
+#include "trace.h"
+#include "audio_stats.h"
+#include "led.h"
+#include "rt_log.h"
+#include "persist_stats.h"
+#include "pipeline_wdt.h"
+#include "SSD1306/lcd.h"
+#include "display.h"
+#include "sys_metrics.h"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-variable"
+static const char *TAG = "METRICS";
+#pragma GCC diagnostic pop
+
+//wake period, must stay well below the task watchdog timeout
+#define METRICS_WAKE_MS         1000
+
+//the reports keep their previous values in statics, console and metrics task print them in turn
+static StaticSemaphore_t report_mutex_buf;
+static SemaphoreHandle_t report_mutex = NULL;
+
+
+//rates since the last periodic report, only that one starts a new window
+static void display_report(bool periodic) {
+    static lcd_stats_t last;
+    static display_stats_t last_task;
+    static int64_t last_us = 0;
+    int64_t now_us = esp_timer_get_time();
+    lcd_stats_t lcd;
+    display_stats_t task;
+    lcd_get_stats(&lcd);
+    display_get_stats(&task);
+
+    uint32_t elapsed_ms = (now_us - last_us) / 1000;
+    if (elapsed_ms == 0) return;
+    ESP_LOGI(TAG, "display %s: task %.1f wakeups/s cpu %.2f%%  %.1f fps  i2c %.0f bytes/s busy %.1f%%",
+             task.streaming ? "streaming" : "idle", (task.wakeups - last_task.wakeups) * 1000.0f / elapsed_ms,
+             (task.busy_us - last_task.busy_us) / (elapsed_ms * 10.0f), (lcd.frames - last.frames) * 1000.0f / elapsed_ms,
+             (lcd.bytes - last.bytes) * 1000.0f / elapsed_ms, (lcd.bus_us - last.bus_us) / (elapsed_ms * 10.0f));
+    ESP_LOGI(TAG, "display last frame: %u transactions %u bytes %u us  deferred: %u",
+             lcd.frame_transactions, lcd.frame_bytes, lcd.frame_bus_us, lcd.deferred - last.deferred);
+    if (display_dropped()) ESP_LOGW(TAG, "display updates dropped: %u", display_dropped());
+    if (!periodic) return;
+    last = lcd;
+    last_task = task;
+    last_us = now_us;
+}
+
+static void metrics_report(bool periodic) {
+    bt_i2s_counters_t i2s;
+    audio_stats_snapshot_t audio;
+    bt_i2s_get_counters(&i2s);
+    audio_stats_snapshot(&audio, esp_timer_get_time());
+
+    ESP_LOGI(TAG, "heap free: %u  min: %u  largest block: %u",
+             heap_caps_get_free_size(MALLOC_CAP_8BIT),
+             heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT),
+             heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+    ESP_LOGI(TAG, "packets: %u  ringbuf in: %llu  out: %llu  failed writes: %u",
+             bt_app_get_pkt_cnt(), i2s.bytes_in, i2s.bytes_out, i2s.short_writes);
+    audio_stats_print(&audio);
+    display_report(periodic);
+#if CONFIG_PIPELINE_WDT_ENABLE
+    if (pipeline_wdt_input_stalls() || pipeline_wdt_output_stalls()) {
+        ESP_LOGW(TAG, "pipeline stalls: input %u  output %u", pipeline_wdt_input_stalls(), pipeline_wdt_output_stalls());
+    }
+#endif
+    if (rt_log_dropped()) ESP_LOGW(TAG, "real-time log records dropped: %u", rt_log_dropped());
+    task_stats_print();
+#if CONFIG_PROBE_ENABLE
+    probe_dump();
+#endif
+}
+
+void sys_metrics_lock() {
+    xSemaphoreTake(report_mutex, portMAX_DELAY);
+}
+
+void sys_metrics_unlock() {
+    xSemaphoreGive(report_mutex);
+}
+
+void sys_metrics_report() {
+    sys_metrics_lock();
+    metrics_report(false);
+    sys_metrics_unlock();
+}
+
+static void sys_metrics_task(void *arg) {
+    TickType_t last_wake = xTaskGetTickCount();
+    uint32_t elapsed_ms = 0;
+    uint32_t sample_ms = 0;
+    bool boot_reported = false;
+    uint32_t persist_underruns = 0;
+#if CONFIG_AUDIO_STATS_LED_INDICATOR
+    uint32_t underruns = 0;
+    uint8_t led_restore = 0;
+#endif
+
+    esp_task_wdt_add(NULL);
+    for (;;) {
+        vTaskDelayUntil(&last_wake, METRICS_WAKE_MS / portTICK_PERIOD_MS);
+        esp_task_wdt_reset();
+        trace_dump_pending();
+
+        //underrun counter restarts with every audio session
+        uint32_t session_underruns = audio_stats_underruns();
+        if (session_underruns < persist_underruns) persist_underruns = 0;
+        persist_stats_update(esp_timer_get_time() / 1000000, session_underruns - persist_underruns,
+                             audio_stats_cb_latency_max(), heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT));
+        persist_underruns = session_underruns;
+
+#if CONFIG_AUDIO_STATS_LED_INDICATOR
+        //flash the led red for one period on new underruns
+        if (led_restore) {
+            led_on(led_restore);
+            led_restore = 0;
+        }
+        if (audio_stats_underruns() > underruns && audio_stats_active()) {
+            led_restore = led_get();
+            led_on(RED);
+        }
+        underruns = audio_stats_underruns();
+#endif
+
+        //boot times including reset to first audio are complete with the first packet
+        if (!boot_reported && boot_time_get(BOOT_PHASE_FIRST_AUDIO) != 0) {
+            boot_reported = true;
+            boot_time_report();
+        }
+
+        sample_ms += METRICS_WAKE_MS;
+        if (sample_ms >= CONFIG_TASK_STATS_PERIOD_S * 1000) {
+            sample_ms = 0;
+            sys_metrics_lock();
+            task_stats_sample();
+            sys_metrics_unlock();
+        }
+
+        elapsed_ms += METRICS_WAKE_MS;
+        if (elapsed_ms >= CONFIG_METRICS_PERIOD_S * 1000) {
+            elapsed_ms = 0;
+            sys_metrics_lock();
+            metrics_report(true);
+            sys_metrics_unlock();
+        }
+    }
+}
+
+void sys_metrics_start() {
+    report_mutex = xSemaphoreCreateMutexStatic(&report_mutex_buf);
+    xTaskCreate(
+        sys_metrics_task,       /* Task function. */
+        "SysMetrics",           /* String with name of task. */
+        2560,                   /* Stack size in bytes. */
+        NULL,                   /* Parameter passed as input of the task */
+        1,                      /* Priority of the task. */
+        NULL
+    );                          /* Task handle. */
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+
+/**
+ * @brief     start the periodic system metrics reporter task
+ */
+void sys_metrics_start();
+
+/**
+ * @brief     log heap, pipeline counters and the last task stats sample now, without starting
+ *            a new window for the periodic report
+ */
+void sys_metrics_report();
+
+/**
+ * @brief     serialises task stats sampling and the reports that share statics, task_stats_print() and probe_dump()
+ */
+void sys_metrics_lock();
+void sys_metrics_unlock();
@@ -0,0 +1,107 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#include "task_stats.h"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-variable"
+static const char *TAG = "TASKS";
+#pragma GCC diagnostic pop
+
+#if !CONFIG_FREERTOS_USE_TRACE_FACILITY || !CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+#error "task stats need CONFIG_FREERTOS_USE_TRACE_FACILITY and CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS"
+#endif
+
+
+typedef struct {
+    UBaseType_t number;
+    uint32_t run_time;
+} run_time_t;
+
+static TaskStatus_t status[TASK_STATS_MAX_TASKS];
+static run_time_t last_run_time[TASK_STATS_MAX_TASKS];
+static size_t last_count = 0;
+static uint32_t last_total = 0;
+
+static task_stat_t stats[TASK_STATS_MAX_TASKS];
+static size_t stats_count = 0;
+static uint16_t core_load[2] = { 0, 0 };
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+
+static uint32_t last_run_time_of(UBaseType_t number) {
+    for (size_t i = 0; i < last_count; i++) {
+        if (last_run_time[i].number == number) return last_run_time[i].run_time;
+    }
+    //task is new, count from zero
+    return 0;
+}
+
+void task_stats_sample() {
+    uint32_t total;
+    size_t count = uxTaskGetSystemState(status, TASK_STATS_MAX_TASKS, &total);
+    if (count == 0) {
+        ESP_LOGW(TAG, "more than %u tasks, no stats", TASK_STATS_MAX_TASKS);
+        return;
+    }
+    uint32_t elapsed = total - last_total;
+    if (elapsed == 0) return;
+
+    TaskHandle_t idle[2] = { xTaskGetIdleTaskHandleForCPU(0), xTaskGetIdleTaskHandleForCPU(1) };
+    uint16_t idle_permille[2] = { 1000, 1000 };
+
+    portENTER_CRITICAL(&stats_lock);
+    for (size_t i = 0; i < count; i++) {
+        uint32_t delta = status[i].ulRunTimeCounter - last_run_time_of(status[i].xTaskNumber);
+        uint32_t permille = (uint64_t)delta * 1000 / elapsed;
+        strlcpy(stats[i].name, status[i].pcTaskName, sizeof(stats[i].name));
+        stats[i].priority = status[i].uxCurrentPriority;
+        BaseType_t affinity = xTaskGetAffinity(status[i].xHandle);
+        stats[i].core = affinity == tskNO_AFFINITY ? -1 : affinity;
+        stats[i].cpu_permille = permille > 1000 ? 1000 : permille;
+        stats[i].stack_free_min = status[i].usStackHighWaterMark;
+        for (uint8_t c = 0; c < 2; c++) {
+            if (status[i].xHandle == idle[c]) idle_permille[c] = stats[i].cpu_permille;
+        }
+    }
+    stats_count = count;
+    core_load[0] = 1000 - idle_permille[0];
+    core_load[1] = 1000 - idle_permille[1];
+    portEXIT_CRITICAL(&stats_lock);
+
+    for (size_t i = 0; i < count; i++) {
+        last_run_time[i].number = status[i].xTaskNumber;
+        last_run_time[i].run_time = status[i].ulRunTimeCounter;
+    }
+    last_count = count;
+    last_total = total;
+}
+
+size_t task_stats_get(task_stat_t *out, size_t max, uint16_t core_load_permille[2]) {
+    portENTER_CRITICAL(&stats_lock);
+    size_t count = stats_count < max ? stats_count : max;
+    memcpy(out, stats, count * sizeof(task_stat_t));
+    if (core_load_permille) {
+        core_load_permille[0] = core_load[0];
+        core_load_permille[1] = core_load[1];
+    }
+    portEXIT_CRITICAL(&stats_lock);
+    return count;
+}
+
+void task_stats_print() {
+    static task_stat_t copy[TASK_STATS_MAX_TASKS];
+    uint16_t load[2];
+    size_t count = task_stats_get(copy, TASK_STATS_MAX_TASKS, load);
+
+    ESP_LOGI(TAG, "cpu load core 0: %u.%u%%  core 1: %u.%u%%", load[0] / 10, load[0] % 10, load[1] / 10, load[1] % 10);
+    ESP_LOGI(TAG, "%-16s prio core   cpu%%  stack free", "task");
+    for (size_t i = 0; i < count; i++) {
+        ESP_LOGI(TAG, "%-16s %4u %4d %4u.%u %11u", copy[i].name, copy[i].priority, copy[i].core,
+                 copy[i].cpu_permille / 10, copy[i].cpu_permille % 10, copy[i].stack_free_min);
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define TASK_STATS_MAX_TASKS    24
+
+typedef struct {
+    char name[16];
+    uint8_t priority;
+    int8_t core;                /*!< -1 if not pinned */
+    uint16_t cpu_permille;      /*!< share of one core during the last sample window */
+    uint32_t stack_free_min;    /*!< stack high water mark in bytes */
+} task_stat_t;
+
+
+/**
+ * @brief     take a runtime stats sample and compute per task load since the previous sample
+ */
+void task_stats_sample();
+
+/**
+ * @brief     copy the last computed stats, returns number of tasks
+ */
+size_t task_stats_get(task_stat_t *stats, size_t max, uint16_t core_load_permille[2]);
+
+/**
+ * @brief     log the last computed stats as table
+ */
+void task_stats_print();
@@ -1,6 +1,10 @@
 #include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
 #include "timer_delay.h"
 
+#define US_PER_TICK     (portTICK_PERIOD_MS * 1000)
+
 unsigned long IRAM_ATTR micros()
 {
     return (unsigned long) (esp_timer_get_time());
@@ -9,16 +13,12 @@ unsigned long IRAM_ATTR micros()
 
 void IRAM_ATTR delay_us(uint32_t us)
 {
-    uint32_t m = micros();
-    if (us) {
-        uint32_t e = (m + us);
-        if(m > e) {
-            while(micros() > e) {
-                NOP();
-            }
-        }
-        while(micros() < e) {
-            NOP();
-        }
+    int64_t e = esp_timer_get_time() + us;
+    //vTaskDelay(n) may return up to one tick early, leave that tick to the spin loop
+    if (us >= 2 * US_PER_TICK && xTaskGetSchedulerState() == taskSCHEDULER_RUNNING) {
+        vTaskDelay(us / US_PER_TICK - 1);
+    }
+    while (esp_timer_get_time() < e) {
+        NOP();
     }
 }
@@ -4,5 +4,9 @@
 
 #define NOP() asm volatile ("nop")
 
-unsigned long IRAM_ATTR us();
+unsigned long IRAM_ATTR micros();
+
+/**
+ * @brief     busy wait for sub-millisecond delays, longer delays sleep whole ticks and only spin the rest
+ */
 void IRAM_ATTR delay_us(uint32_t us);
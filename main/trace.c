@@ -0,0 +1,94 @@
+#include <stdio.h>
+
+#include "trace.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_task_wdt.h"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-variable"
+static const char *TAG = "TRACE";
+#pragma GCC diagnostic pop
+
+#define TRACE_PRINT(fmt, ...)   ESP_LOGI(TAG, fmt, ##__VA_ARGS__)
+#define TRACE_NOW()             ((uint32_t)esp_timer_get_time())
+//a dump takes seconds on the UART, longer than the task watchdog allows the metrics task
+#define TRACE_WDT_RESET()       esp_task_wdt_reset()
+#else
+#include <time.h>
+
+#define TRACE_PRINT(fmt, ...)   printf(fmt "\n", ##__VA_ARGS__)
+
+static uint32_t trace_now_host() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+#define TRACE_NOW()             trace_now_host()
+#define TRACE_WDT_RESET()
+#endif
+
+#if CONFIG_TRACE_ENABLE
+#define TRACE_RECORDS           CONFIG_TRACE_RECORDS
+#else
+#define TRACE_RECORDS           1
+#endif
+#define TRACE_RECORDS_PER_LINE  8
+
+_Static_assert((TRACE_RECORDS & (TRACE_RECORDS - 1)) == 0, "trace records must be a power of 2");
+
+
+static const char *trace_event_names[TRACE_EVT_MAX] = {
+    "none", "pkt_in", "ring_write", "ring_read", "i2s_done", "a2d", "avrc_ct", "avrc_tg", "display_flush"
+};
+
+static trace_record_t trace_buf[TRACE_RECORDS];
+static uint32_t trace_head = 0;
+static volatile bool trace_paused = false;
+static volatile bool trace_dump_requested = false;
+
+
+void trace_record(trace_event_t event, uint32_t arg) {
+    if (trace_paused) return;
+    uint32_t idx = __atomic_fetch_add(&trace_head, 1, __ATOMIC_RELAXED) & (TRACE_RECORDS - 1);
+    trace_buf[idx].ts = TRACE_NOW();
+    trace_buf[idx].event_arg = (uint32_t)event << TRACE_ARG_BITS | (arg > TRACE_ARG_MASK ? TRACE_ARG_MASK : arg);
+}
+
+void trace_request_dump() {
+    trace_dump_requested = true;
+}
+
+bool trace_dump_pending() {
+    if (!trace_dump_requested) return false;
+    trace_dump_requested = false;
+    trace_dump();
+    return true;
+}
+
+void trace_dump() {
+    trace_paused = true;
+    uint32_t head = __atomic_load_n(&trace_head, __ATOMIC_RELAXED);
+    uint32_t count = head < TRACE_RECORDS ? head : TRACE_RECORDS;
+
+    TRACE_PRINT("dumping %u of %u records", (unsigned)count, (unsigned)head);
+    printf("TRACE:BEGIN %u %u\n", (unsigned)count, (unsigned)head);
+    for (uint32_t i = 0; i < count; i++) {
+        trace_record_t *r = &trace_buf[(head - count + i) & (TRACE_RECORDS - 1)];
+        if (i % TRACE_RECORDS_PER_LINE == 0) {
+            TRACE_WDT_RESET();
+            printf("TRACE:");
+        }
+        printf("%08x%08x", (unsigned)r->ts, (unsigned)r->event_arg);
+        if (i % TRACE_RECORDS_PER_LINE == TRACE_RECORDS_PER_LINE - 1 || i == count - 1) printf("\n");
+    }
+    printf("TRACE:END\n");
+    fflush(stdout);
+    trace_paused = false;
+}
+
+const char *trace_event_name(trace_event_t event) {
+    return event < TRACE_EVT_MAX ? trace_event_names[event] : "?";
+}
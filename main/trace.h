@@ -0,0 +1,65 @@
+#pragma once
+
+
+/*
+ * Fixed size binary event trace of the audio pipeline. Producers on any task or core
+ * reserve a slot with one atomic add, the oldest records are overwritten. The dump is
+ * printed as hex lines prefixed with "TRACE:" and decoded on the host by trace_decode.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+
+typedef enum {
+    TRACE_EVT_NONE = 0,
+    TRACE_EVT_PKT_IN,           /*!< bluetooth data callback entered, arg: packet bytes */
+    TRACE_EVT_RING_WRITE,       /*!< ring buffer written, arg: fill level in bytes after write */
+    TRACE_EVT_RING_READ,        /*!< ring buffer item received, arg: fill level in bytes before read */
+    TRACE_EVT_I2S_DONE,         /*!< i2s_write returned, arg: bytes written */
+    TRACE_EVT_A2D,              /*!< A2DP event, arg: event << 8 | state */
+    TRACE_EVT_AVRC_CT,          /*!< AVRCP controller event, arg: event */
+    TRACE_EVT_AVRC_TG,          /*!< AVRCP target event, arg: event */
+    TRACE_EVT_DISPLAY_FLUSH,    /*!< display flush finished, arg: duration in us */
+    TRACE_EVT_MAX
+} trace_event_t;
+
+typedef struct {
+    uint32_t ts;                /*!< esp_timer us, wraps after ~71 minutes */
+    uint32_t event_arg;         /*!< event in the upper 8 bits, argument in the lower 24 bits */
+} trace_record_t;
+
+#define TRACE_ARG_BITS          24
+#define TRACE_ARG_MASK          ((1 << TRACE_ARG_BITS) - 1)
+#define TRACE_EVENT(r)          ((r)->event_arg >> TRACE_ARG_BITS)
+#define TRACE_ARG(r)            ((r)->event_arg & TRACE_ARG_MASK)
+
+#if CONFIG_TRACE_ENABLE
+#define TRACE(event, arg)       trace_record(event, arg)
+#else
+#define TRACE(event, arg)
+#endif
+
+
+void trace_record(trace_event_t event, uint32_t arg);
+
+/**
+ * @brief     ask the metrics task to dump the trace, safe to call from any task
+ */
+void trace_request_dump();
+
+/**
+ * @brief     dump the trace if requested, returns true if dumped
+ */
+bool trace_dump_pending();
+
+/**
+ * @brief     print the trace over the console UART, recording pauses while dumping
+ */
+void trace_dump();
+
+const char *trace_event_name(trace_event_t event);
@@ -0,0 +1,157 @@
+#include <string.h>
+#include <sys/param.h>
+
+#include "esp_err.h"
+#include "esp_log.h"
+
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "sdkconfig.h"
+
+#include "bt_app_core.h"
+#include "bt_app_av.h"
+#include "display.h"
+#include "tuning.h"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-variable"
+static const char *TAG = "TUNING";
+#pragma GCC diagnostic pop
+
+#define TUNING_KEY              "params"
+//2: vu_decay_ms is ms per dB instead of per column, display_refresh_ms the VU frame period
+#define TUNING_VERSION          2
+//columns of the 80 dB VU bar, version 1 decay was per column
+#define TUNING_V1_VU_COLUMNS    39
+
+
+static const latency_config_t latency_configs[LATENCY_MAX] = {
+    { .ringbuf_size = 8 * 1024,     .dma_buf_count = 6,                 .dma_buf_len = 120 },
+    { .ringbuf_size = RINGBUF_SIZE, .dma_buf_count = I2S_DMA_BUF_COUNT, .dma_buf_len = I2S_DMA_BUF_LEN },
+    { .ringbuf_size = RINGBUF_SIZE, .dma_buf_count = 16,                .dma_buf_len = 256 },
+};
+static const char *latency_names[LATENCY_MAX] = { "low", "normal", "safe" };
+
+static const tuning_t tuning_default = {
+    .latency = LATENCY_NORMAL,
+    .vol_min = 30,
+    .vol_power_x10 = 30,
+    .vu_decay_ms = 85,
+    .display_refresh_ms = 1000 / CONFIG_DISPLAY_VU_FPS,
+};
+
+static tuning_t tuning;
+
+
+static esp_err_t tuning_save() {
+    nvs_handle_t save_handle;
+    uint8_t blob[1 + sizeof(tuning_t)];
+
+    esp_err_t err = nvs_open(TUNING_NAMESPACE, NVS_READWRITE, &save_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "%s: nvs_open failed: %d", __func__, err);
+        return err;
+    }
+    blob[0] = TUNING_VERSION;
+    memcpy(&blob[1], &tuning, sizeof(tuning_t));
+    err = nvs_set_blob(save_handle, TUNING_KEY, blob, sizeof(blob));
+    if (err == ESP_OK) err = nvs_commit(save_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "%s: nvs write failed: %d", __func__, err);
+    }
+    nvs_close(save_handle);
+    return err;
+}
+
+//same layout, older versions meant other units or had other defaults
+static void tuning_migrate(uint8_t version) {
+    if (version < 2) {
+        if (tuning.vu_decay_ms == 51) tuning.vu_decay_ms = tuning_default.vu_decay_ms;
+        else tuning.vu_decay_ms = MAX(tuning.vu_decay_ms * TUNING_V1_VU_COLUMNS / 80, 1);
+        if (tuning.display_refresh_ms == 10) tuning.display_refresh_ms = tuning_default.display_refresh_ms;
+    }
+    ESP_LOGI(TAG, "parameters migrated from version %u", version);
+}
+
+static void tuning_apply() {
+    volume_curve_set(tuning.vol_min, tuning.vol_power_x10 / 10.0);
+    display_set_vu_decay(tuning.vu_decay_ms);
+    display_set_refresh(tuning.display_refresh_ms);
+}
+
+void tuning_init() {
+    nvs_handle_t load_handle;
+    uint8_t blob[1 + sizeof(tuning_t)];
+    size_t size = sizeof(blob);
+    uint8_t version = TUNING_VERSION;
+
+    tuning = tuning_default;
+    if (nvs_open(TUNING_NAMESPACE, NVS_READONLY, &load_handle) == ESP_OK) {
+        if (nvs_get_blob(load_handle, TUNING_KEY, blob, &size) == ESP_OK && size == sizeof(blob) && blob[0] >= 1 && blob[0] <= TUNING_VERSION) {
+            memcpy(&tuning, &blob[1], sizeof(tuning_t));
+            if (tuning.latency >= LATENCY_MAX) tuning.latency = LATENCY_NORMAL;
+            version = blob[0];
+            ESP_LOGI(TAG, "parameters loaded");
+        }
+        nvs_close(load_handle);
+        if (version < TUNING_VERSION) {
+            tuning_migrate(version);
+            tuning_save();
+        }
+    }
+    tuning_apply();
+}
+
+const tuning_t *tuning_get() {
+    return &tuning;
+}
+
+const latency_config_t *tuning_latency_config(latency_profile_t profile) {
+    return &latency_configs[profile < LATENCY_MAX ? profile : LATENCY_NORMAL];
+}
+
+const char *tuning_latency_name(latency_profile_t profile) {
+    return profile < LATENCY_MAX ? latency_names[profile] : "?";
+}
+
+esp_err_t tuning_set_latency(latency_profile_t profile) {
+    if (profile >= LATENCY_MAX) return ESP_ERR_INVALID_ARG;
+    tuning.latency = profile;
+    return tuning_save();
+}
+
+esp_err_t tuning_set_volume_curve(uint16_t vol_min, uint8_t vol_power_x10) {
+    if (vol_min < 1 || vol_min >= 65536 / 2 || vol_power_x10 < 10 || vol_power_x10 > 60) return ESP_ERR_INVALID_ARG;
+    tuning.vol_min = vol_min;
+    tuning.vol_power_x10 = vol_power_x10;
+    volume_curve_set(tuning.vol_min, tuning.vol_power_x10 / 10.0);
+    return tuning_save();
+}
+
+esp_err_t tuning_set_vu_decay(uint16_t decay_ms) {
+    if (decay_ms < 1 || decay_ms > 1000) return ESP_ERR_INVALID_ARG;
+    tuning.vu_decay_ms = decay_ms;
+    display_set_vu_decay(decay_ms);
+    return tuning_save();
+}
+
+esp_err_t tuning_set_display_refresh(uint16_t refresh_ms) {
+    if (refresh_ms < 10 || refresh_ms > 1000) return ESP_ERR_INVALID_ARG;
+    tuning.display_refresh_ms = refresh_ms;
+    display_set_refresh(refresh_ms);
+    return tuning_save();
+}
+
+esp_err_t tuning_reset() {
+    tuning = tuning_default;
+    tuning_apply();
+    return tuning_save();
+}
+
+void tuning_print() {
+    const latency_config_t *l = tuning_latency_config(tuning.latency);
+    ESP_LOGI(TAG, "latency: %s (ringbuf %u bytes, dma %u x %u frames)", tuning_latency_name(tuning.latency),
+             l->ringbuf_size, l->dma_buf_count, l->dma_buf_len);
+    ESP_LOGI(TAG, "volume curve: min %u  power %u.%u", tuning.vol_min, tuning.vol_power_x10 / 10, tuning.vol_power_x10 % 10);
+    ESP_LOGI(TAG, "vu decay: %u ms/dB  display refresh: %u ms", tuning.vu_decay_ms, tuning.display_refresh_ms);
+}
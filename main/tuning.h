@@ -0,0 +1,55 @@
+#pragma once
+
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#define TUNING_NAMESPACE        "tuning"
+
+typedef enum {
+    LATENCY_LOW = 0,
+    LATENCY_NORMAL,
+    LATENCY_SAFE,
+    LATENCY_MAX
+} latency_profile_t;
+
+typedef struct {
+    uint32_t ringbuf_size;
+    uint16_t dma_buf_count;
+    uint16_t dma_buf_len;
+} latency_config_t;
+
+/* runtime adjustable pipeline parameters, persisted in nvs */
+typedef struct {
+    uint8_t latency;                /*!< latency_profile_t, applied on the next connection */
+    uint16_t vol_min;               /*!< volume factor at 1% */
+    uint8_t vol_power_x10;          /*!< exponent of the volume curve * 10 */
+    uint16_t vu_decay_ms;           /*!< peak meter fall time in ms per dB */
+    uint16_t display_refresh_ms;    /*!< VU meter frame period while streaming */
+} tuning_t;
+
+
+/**
+ * @brief     load the parameters from nvs, defaults on first boot
+ */
+void tuning_init();
+
+const tuning_t *tuning_get();
+
+/**
+ * @brief     ring buffer and DMA geometry of a profile
+ */
+const latency_config_t *tuning_latency_config(latency_profile_t profile);
+const char *tuning_latency_name(latency_profile_t profile);
+
+esp_err_t tuning_set_latency(latency_profile_t profile);
+esp_err_t tuning_set_volume_curve(uint16_t vol_min, uint8_t vol_power_x10);
+esp_err_t tuning_set_vu_decay(uint16_t decay_ms);
+esp_err_t tuning_set_display_refresh(uint16_t refresh_ms);
+
+/**
+ * @brief     restore and save the defaults
+ */
+esp_err_t tuning_reset();
+
+void tuning_print();
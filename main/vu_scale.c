@@ -0,0 +1,90 @@
+#include <sys/param.h>
+
+#include "vu_scale.h"
+
+//20 * log10(2), dB per octave in 1/256 dB
+#define DB_PER_LOG2             1541
+//longer gaps between updates count as this
+#define ELAPSED_MAX_MS          1000
+
+//log2(1 + (i + 0.5) / 64) in 1/256
+static const uint8_t log2_fraction[64] = {
+      3,   9,  14,  20,  25,  30,  36,  41,  46,  51,  56,  61,  66,  71,  75,  80,
+     85,  89,  94,  98, 103, 107, 111, 116, 120, 124, 128, 132, 136, 140, 144, 148,
+    152, 155, 159, 163, 167, 170, 174, 178, 181, 185, 188, 192, 195, 198, 202, 205,
+    208, 212, 215, 218, 221, 224, 228, 231, 234, 237, 240, 243, 246, 249, 252, 255,
+};
+
+
+//log2 in 1/256 from the highest set bit and the 6 bits below it, level > 0
+static int32_t vu_log2(uint32_t level) {
+    int msb = 31 - __builtin_clz(level);
+    uint32_t fraction = msb >= 6 ? level >> (msb - 6) : level << (6 - msb);
+    return msb * 256 + log2_fraction[fraction & 63];
+}
+
+void vu_scale_init(vu_scale_t *scale, uint32_t max, uint8_t x_start, uint8_t x_end) {
+    //80db -> factor 10000
+    scale->min = max / 10000;
+    scale->log2_max = vu_log2(MAX(max, 1));
+    scale->x_start = x_start;
+    scale->x_end = x_end;
+}
+
+int32_t vu_scale_db(const vu_scale_t *scale, uint32_t level) {
+    if (level <= scale->min) return VU_DB_MIN;
+    int32_t db = (vu_log2(level) - scale->log2_max) * DB_PER_LOG2 / 256;
+    return MAX(MIN(db, 0), VU_DB_MIN);
+}
+
+uint8_t vu_scale_db_x(const vu_scale_t *scale, int32_t db) {
+    db = MAX(MIN(db, 0), VU_DB_MIN);
+    return scale->x_start + ((db - VU_DB_MIN) * (scale->x_end - scale->x_start) + VU_DB_RANGE * 128) / (VU_DB_RANGE * 256);
+}
+
+uint8_t vu_scale_x(const vu_scale_t *scale, uint32_t level) {
+    return vu_scale_db_x(scale, vu_scale_db(scale, level));
+}
+
+
+void vu_meter_init(vu_meter_t *meter) {
+    meter->db = VU_DB_MIN;
+    meter->peak_db = VU_DB_MIN;
+    meter->peak_ms = 0;
+}
+
+void vu_meter_update(vu_meter_t *meter, const vu_ballistics_t *ballistics, int32_t db, uint32_t elapsed_ms) {
+    db = MAX(MIN(db, 0), VU_DB_MIN);
+    elapsed_ms = MIN(elapsed_ms, ELAPSED_MAX_MS);
+    int32_t diff = db - meter->db;
+
+    if (diff > 0 || (diff < 0 && ballistics->fall_ms_per_db == 0)) {
+        //first order step response, time constant integration time / 4.6 for 99%, both in 1/16 ms,
+        //1 - exp(-dt / tau) approximated by 2 dt / (2 tau + dt)
+        int32_t tau = ballistics->integration_ms * 348 / 100;
+        int32_t dt = elapsed_ms * 16;
+        int32_t span = 2 * tau + dt;
+        //rounded away from 0 so the reading always arrives
+        if (dt >= 2 * tau) meter->db = db;
+        else meter->db += (diff * 2 * dt + (diff > 0 ? span - 1 : 1 - span)) / span;
+    }
+    else if (diff < 0) {
+        meter->db = MAX(meter->db - (int32_t)(elapsed_ms * 256 / ballistics->fall_ms_per_db), db);
+    }
+
+    if (meter->db >= meter->peak_db) {
+        meter->peak_db = meter->db;
+        meter->peak_ms = 0;
+    }
+    else {
+        meter->peak_ms += elapsed_ms;
+        if (meter->peak_ms >= ballistics->peak_hold_ms) {
+            meter->peak_db = meter->db;
+            meter->peak_ms = 0;
+        }
+    }
+}
+
+bool vu_meter_at_rest(const vu_meter_t *meter) {
+    return meter->db <= VU_DB_MIN && meter->peak_db <= VU_DB_MIN;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+
+/*
+ * Logarithmic mapping of a VU meter level to a display column, 80 dB below max at x_start,
+ * and the meter ballistics. Integer only, levels are converted with a log2 table.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* dB values are in 1/256 dB, 0 is max */
+#define VU_DB_RANGE             80
+#define VU_DB_MIN               (-VU_DB_RANGE * 256)
+
+typedef struct {
+    uint32_t min;                   /*!< levels at or below map to x_start */
+    int32_t log2_max;               /*!< log2 of max in 1/256 */
+    uint8_t x_start;
+    uint8_t x_end;
+} vu_scale_t;
+
+void vu_scale_init(vu_scale_t *scale, uint32_t max, uint8_t x_start, uint8_t x_end);
+
+/**
+ * @brief     dB of a peak level below max, VU_DB_MIN .. 0
+ */
+int32_t vu_scale_db(const vu_scale_t *scale, uint32_t level);
+
+/**
+ * @brief     column x_start..x_end for a dB value
+ */
+uint8_t vu_scale_db_x(const vu_scale_t *scale, int32_t db);
+
+/**
+ * @brief     column x_start..x_end for a peak level
+ */
+uint8_t vu_scale_x(const vu_scale_t *scale, uint32_t level);
+
+/*
+ * A level step is 99% reached after the integration time. Falling, a PPM (IEC 60268-10)
+ * drops linearly by fall_ms_per_db, type I takes 1.7 s for 20 dB. With fall_ms_per_db 0 the
+ * reading falls with the integration time as well, like a VU meter (IEC 60268-17, 300 ms).
+ */
+typedef struct {
+    uint16_t integration_ms;
+    uint16_t fall_ms_per_db;
+    uint16_t peak_hold_ms;          /*!< 0: no peak marker */
+} vu_ballistics_t;
+
+typedef struct {
+    int32_t db;                     /*!< reading */
+    int32_t peak_db;                /*!< highest reading of the hold time */
+    uint32_t peak_ms;               /*!< since the peak was reached */
+} vu_meter_t;
+
+void vu_meter_init(vu_meter_t *meter);
+
+/**
+ * @brief     moves the reading towards the dB value of the last elapsed_ms
+ */
+void vu_meter_update(vu_meter_t *meter, const vu_ballistics_t *ballistics, int32_t db, uint32_t elapsed_ms);
+
+/**
+ * @brief     reading and peak marker are down at VU_DB_MIN
+ */
+bool vu_meter_at_rest(const vu_meter_t *meter);